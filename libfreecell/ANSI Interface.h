@@ -20,7 +20,6 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Prototypes
-void parseTableau(const char* cardDescriptions, Tableau* t);
 void printTableau(const Tableau& t);
 void printSolution(const vector<CardMove>& soln);
 
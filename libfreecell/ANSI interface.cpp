@@ -22,12 +22,23 @@
 // C++ Includes
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <iomanip>
 
 // C includes
 #include <assert.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <time.h>
+#include <string.h>
+#include <math.h>
 
 // Project includes
 #include "Card.h"
@@ -36,12 +47,65 @@
 #include "Location.h"
 #include "Tableau.h"
 #include "Solve FreeCell.h"
+#include "Deals.h"
 #include "ANSI Interface.h"
 
 using namespace std;
 
 extern void solveFreeCell(vector<CardMove>* moveList);
-extern void optimizeMoves(vector<CardMove>* moveList);
+extern void optimizeMoves(vector<CardMove>* moveList, const vector<Tableau>& tableaus);
+
+// how batch mode sets up the Solver of each of its threads
+struct BatchOptions {
+  SolveStrategy strategy;
+  int portfolioSize;
+  unsigned int searchThreads;
+  unsigned long long nodeLimit;
+  unsigned int timeLimit;
+  size_t tableMemoryLimit;
+  SolverParameters parameters;
+};
+
+// what became of one deal of a batch
+struct BatchResult {
+  string id;
+  const char* status;
+  size_t moves;
+  unsigned long long nodes, pruned, generated;
+  unsigned int maxDepth, bestFoundationCards;
+  double milliseconds, cpuMilliseconds;
+  size_t tableMemory;
+};
+
+// The deals of a batch are read a line at a time by whichever thread is free,
+// and their results written out in the order the deals came in.
+struct Batch {
+  istream* input;
+  // guards input and the two counts after it
+  mutex inputMutex;
+  unsigned long lineNumber;
+  unsigned long dealsRead;
+  // guards the rest
+  mutex outputMutex;
+  // results that finished ahead of an earlier deal, by their place in the
+  // batch
+  map<unsigned long, BatchResult> waiting;
+  unsigned long dealsWritten;
+  vector<BatchResult> results;
+};
+
+static int runBatch(const char* path, unsigned int threadCount,
+                    const BatchOptions& options);
+static void runBatchWorker(Batch* batch, const BatchOptions* options);
+static bool readBatchDeal(Batch* batch, unsigned long* index, string* id,
+                          string* deal);
+static void finishBatchDeal(Batch* batch, unsigned long index,
+                            const BatchResult& result);
+static void writeBatchResult(ostream& out, const BatchResult& result);
+static void writeBatchSummary(ostream& out, const vector<BatchResult>& results,
+                              double seconds, unsigned int threadCount);
+static double percentile(vector<double>* values, double fraction);
+static void printProgress(const SolverProgress& progress, void* context);
 
 ///////////////////////////////////////////////////////////////////////////////
 // Implementations
@@ -50,6 +114,22 @@ extern void optimizeMoves(vector<CardMove>* moveList);
 // The following options are available as arguments:
 // - None: The program expects to receive the tableau definitions on stdin.
 // - 8: The program expects the arguments to be the tableau definitions.
+// Either may be preceded by options:
+// -b: solve with the best-first strategy instead of the default depth-first
+// -p N: race N differently tuned searches on N threads
+// -j N: split the depth-first search between N threads
+// -c FILE: use the solver parameters in FILE, as the autotune tool writes
+// -n N: give up on a deal after expanding N positions
+// -l N: give up on a deal after N milliseconds of searching
+// -k N: give up on a deal once its position tables pass N kilobytes
+// -m N: solve the game Microsoft FreeCell numbers N, instead of reading one
+// -f FILE: solve every deal in FILE, one per line ("-" reads stdin), and
+//   write a line of JSON for each to stdout, then a summary to stderr. A deal
+//   may start with an ID, making nine words; otherwise its line number is
+//   used.
+// -t N: solve that many deals of a batch at once; one per core by default
+// -r N: report how the solve is going to stderr every N milliseconds; not
+//   in batch mode
 
 // A tableau is represented
 // by listing card descriptions with no spaces in between. A card description
@@ -61,15 +141,125 @@ extern void optimizeMoves(vector<CardMove>* moveList);
 int main(int argc, char** argv) {
 	int i;
   vector<Tableau> tableaus;
+  SolveStrategy strategy = kStrategyDepthFirst;
+  int portfolioSize = 0;
+  const char* batchPath = NULL;
+  unsigned int batchThreads = 0;
+  unsigned long long nodeLimit = 0;
+  unsigned int timeLimit = 0;
+  size_t tableMemoryLimit = 0;
+  unsigned int searchThreads = 0;
+  unsigned long dealNumber = 0;
+  bool numberedDeal = false;
+  unsigned int progressInterval = 0;
   
 	tableaus.resize(kNumTableaus);
 
+  while (argc > 1 && argv[1][0] == '-') {
+    if (strcmp(argv[1], "-b") == 0) {
+      strategy = kStrategyBestFirst;
+    }
+    else if (strcmp(argv[1], "-j") == 0 && argc > 2) {
+      strategy = kStrategyParallelDepthFirst;
+      searchThreads = atoi(argv[2]);
+      setSearchThreads(searchThreads);
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-c") == 0 && argc > 2) {
+      SolverParameters parameters = getSolverParameters();
+      if (!loadSolverParameters(argv[2], &parameters)) {
+        cerr << "Can't read solver parameters from " << argv[2] << endl;
+        return 1;
+      }
+      setSolverParameters(parameters);
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-p") == 0 && argc > 2) {
+      portfolioSize = atoi(argv[2]);
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-n") == 0 && argc > 2) {
+      nodeLimit = strtoull(argv[2], NULL, 10);
+      setNodeLimit(nodeLimit);
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-l") == 0 && argc > 2) {
+      timeLimit = atoi(argv[2]);
+      setTimeLimit(timeLimit);
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-k") == 0 && argc > 2) {
+      tableMemoryLimit = (size_t)strtoull(argv[2], NULL, 10) * 1024;
+      setTableMemoryLimit(tableMemoryLimit);
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-m") == 0 && argc > 2) {
+      dealNumber = strtoul(argv[2], NULL, 10);
+      numberedDeal = true;
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-f") == 0 && argc > 2) {
+      batchPath = argv[2];
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-t") == 0 && argc > 2) {
+      batchThreads = atoi(argv[2]);
+      argc--;
+      argv++;
+    }
+    else if (strcmp(argv[1], "-r") == 0 && argc > 2) {
+      progressInterval = atoi(argv[2]);
+      argc--;
+      argv++;
+    }
+    else {
+      cerr << "Unknown option " << argv[1] << endl;
+      return 1;
+    }
+    argc--;
+    argv++;
+  }
+
+  if (batchPath != NULL) {
+    BatchOptions options;
+
+    if (argc != 1) {
+      cerr << "Batch mode takes its deals from the file, not arguments." << endl;
+      return 1;
+    }
+    options.strategy = strategy;
+    options.portfolioSize = portfolioSize;
+    options.searchThreads = searchThreads;
+    options.nodeLimit = nodeLimit;
+    options.timeLimit = timeLimit;
+    options.tableMemoryLimit = tableMemoryLimit;
+    options.parameters = getSolverParameters();
+    return runBatch(batchPath, batchThreads, options);
+  }
+
   setAppend(1); // I really have to fix the constants here...what's a good way to share it
                 // between back and front ends?
   Debug::getDefaultInstance().enable();
   setLogPath("SolveFreeCell log.txt");
+  if (progressInterval > 0) {
+    setProgressCallback(printProgress, NULL, progressInterval);
+  }
 
-	if (argc == 1) {
+	if (numberedDeal && argc == 1) {
+		if (!getMicrosoftDeal(dealNumber, &tableaus)) {
+			cerr << "There is no deal number " << dealNumber << endl;
+			return 1;
+		}
+	}
+	else if (argc == 1) {
 	string inputTableau;
     // read from stdin
     // if there are fewer than eight tokens, we notify the user and abort.
@@ -81,12 +271,18 @@ int main(int argc, char** argv) {
       	cerr << "Not enough tableau descriptions were sent to standard input." << endl;
       	return 1;
       }
-      parseTableau(inputTableau.c_str(), &tableaus[i]);
+      if (!parseTableau(inputTableau.c_str(), &tableaus[i])) {
+        cerr << "Invalid tableau " << inputTableau << endl;
+        return 1;
+      }
     }
   }
 	else if (argc == 9) {
 		for (i = 1; i < argc; i++) {
-			parseTableau(argv[i], &tableaus[i - 1]);
+			if (!parseTableau(argv[i], &tableaus[i - 1])) {
+				cerr << "Invalid tableau " << argv[i] << endl;
+				return 1;
+			}
 		}
 	}
 	else {
@@ -101,50 +297,304 @@ int main(int argc, char** argv) {
 	}
 	
 	vector<CardMove> soln;
+	SolveStatus status;
 	soln.reserve(200);
-	solveFreeCell(&soln, tableaus);		// solve FreeCell game
+	if (portfolioSize > 1) {
+		vector<PortfolioSearch> searches;
+		getDefaultPortfolio(&searches, portfolioSize);
+		status = solveFreeCellPortfolio(&soln, tableaus, searches);
+	}
+	else {
+		status = solveFreeCell(&soln, tableaus, strategy);		// solve FreeCell game
+	}
+	if (status != kSolveSolved) {
+		// show how far it got instead
+		getBestLine(&soln);
+		cout << "No solution (" << getSolveStatusName(status) << "). The best line found gets "
+		     << getSolverStats().bestFoundationCards << " cards to the foundations:" << endl;
+	}
 	printSolution(soln);		// print solution
 
 	return 0;
 }
 
 
-// parseTableau
-// cardDescriptions: a C-style string. The front of the string represents
-// the bottom of the tableau. 
-// t: a pointer to the tableau that cardDescriptions represents
-// on exit, *t is a tableau with the cards described
-// No error checking to ensure cardDescriptions or t are non-null
-void parseTableau(const char* cardDescriptions, Tableau* t) {
-	unsigned char suitChar, lengthOfNum;
-	Card card;
-	do {
-		// atoi correctly returns the number even when non-digits follow
-		card.num = atoi(cardDescriptions);
-		// Need to determine location of the suit character; card number is
-		// 1 *or* 2 characters.
-		lengthOfNum = 1 + (card.num > 9 ? 1 : 0);
-		suitChar = *(cardDescriptions + lengthOfNum);
-		switch (toupper(suitChar)) {
-			case 'C':
-				card.suit = clubs;
-				break;
-			case 'D':
-				card.suit = diamonds;
-				break;
-			case 'H':
-				card.suit = hearts;
-				break;
-			case 'S':
-				card.suit = spades;
-				break;
-			default:
-				exit(1);
-				break;
-		}
-		t->place(card);			// copies the card to the tableau
-		cardDescriptions += 1 + lengthOfNum; // advances the ptr on the string
-	} while (*cardDescriptions != '\0');
+// runBatch
+// Solves the deals in the file at path ("-" for stdin) on threadCount
+// threads, each with a Solver of its own, so a batch costs one process
+// however many deals it holds. Every deal's solver is seeded from the deal's
+// place in the batch, so the searches don't depend on the number of threads;
+// the peephole optimizer has a time limit, though, so solution lengths can.
+static int runBatch(const char* path, unsigned int threadCount,
+                    const BatchOptions& options) {
+  Batch batch;
+  ifstream file;
+  vector<thread> threads;
+  chrono::steady_clock::time_point start;
+  double seconds;
+  unsigned int i;
+
+  if (strcmp(path, "-") == 0) {
+    batch.input = &cin;
+  }
+  else {
+    file.open(path);
+    if (!file) {
+      cerr << "Can't read deals from " << path << endl;
+      return 1;
+    }
+    batch.input = &file;
+  }
+  if (threadCount == 0) {
+    threadCount = thread::hardware_concurrency();
+    if (threadCount == 0) {
+      threadCount = 1;
+    }
+  }
+  batch.lineNumber = 0;
+  batch.dealsRead = 0;
+  batch.dealsWritten = 0;
+
+  start = chrono::steady_clock::now();
+  for (i = 0; i < threadCount; i++) {
+    threads.push_back(thread(runBatchWorker, &batch, &options));
+  }
+  for (i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+  seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout.flush();
+  writeBatchSummary(cerr, batch.results, seconds, threadCount);
+  return 0;
+}
+
+// runBatchWorker
+// The body of each batch thread: takes deals until there are none left.
+static void runBatchWorker(Batch* batch, const BatchOptions* options) {
+  Solver solver;
+  unsigned long index = 0;
+  string deal;
+  vector<Tableau> tableaus;
+  vector<CardMove> solution;
+  vector<PortfolioSearch> searches;
+  BatchResult result;
+  SolveStatus status;
+  chrono::steady_clock::time_point start;
+
+  solver.setParameters(options->parameters);
+  solver.setSearchThreads(options->searchThreads);
+  solver.setNodeLimit(options->nodeLimit);
+  solver.setTimeLimit(options->timeLimit);
+  solver.setTableMemoryLimit(options->tableMemoryLimit);
+  while (readBatchDeal(batch, &index, &result.id, &deal)) {
+    result.moves = 0;
+    result.nodes = 0;
+    result.pruned = 0;
+    result.generated = 0;
+    result.maxDepth = 0;
+    result.bestFoundationCards = 0;
+    result.milliseconds = 0;
+    result.cpuMilliseconds = 0;
+    result.tableMemory = 0;
+    if (!parseDeal(deal, &tableaus)) {
+      result.status = "invalid_deal";
+      finishBatchDeal(batch, index, result);
+      continue;
+    }
+
+    solver.setRandomSeed((unsigned int)index + 1);
+    start = chrono::steady_clock::now();
+    if (options->portfolioSize > 1) {
+      solver.getDefaultPortfolio(&searches, options->portfolioSize);
+      status = solver.solvePortfolio(&solution, tableaus, searches);
+    }
+    else {
+      status = solver.solve(&solution, tableaus, options->strategy);
+    }
+    result.milliseconds =
+      chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    if (status == kSolveSolved && !solver.validateSolution(solution, tableaus)) {
+      result.status = "invalid_solution";
+    }
+    else {
+      result.status = getSolveStatusName(status);
+    }
+    result.moves = solution.size();
+    const SolverStats& stats = solver.getStats();
+    result.nodes = stats.nodesExpanded;
+    result.pruned = stats.positionsPruned;
+    result.generated = stats.movesGenerated;
+    result.maxDepth = stats.maxDepth;
+    result.bestFoundationCards = stats.bestFoundationCards;
+    result.cpuMilliseconds = stats.cpuTime * 1000;
+    result.tableMemory = stats.tableMemory;
+    finishBatchDeal(batch, index, result);
+  }
+}
+
+// readBatchDeal
+// Takes the next deal of the batch, skipping blank lines and comments. The
+// ID is the first of nine words, or else the line number. Returns false once
+// the input runs out.
+static bool readBatchDeal(Batch* batch, unsigned long* index, string* id,
+                          string* deal) {
+  lock_guard<mutex> lock(batch->inputMutex);
+  string line, word;
+  vector<string> words;
+
+  while (getline(*batch->input, line)) {
+    batch->lineNumber++;
+    istringstream fields(line);
+
+    words.clear();
+    while (fields >> word) {
+      words.push_back(word);
+    }
+    if (words.empty() || words[0][0] == '#') {
+      continue;
+    }
+    if (words.size() == size_t(kNumTableaus) + 1) {
+      *id = words[0];
+      words.erase(words.begin());
+    }
+    else {
+      ostringstream number;
+      number << batch->lineNumber;
+      *id = number.str();
+    }
+    deal->clear();
+    for (size_t i = 0; i < words.size(); i++) {
+      if (i > 0) {
+        *deal += ' ';
+      }
+      *deal += words[i];
+    }
+    *index = batch->dealsRead++;
+    return true;
+  }
+  return false;
+}
+
+// finishBatchDeal
+// Writes out the result for the deal at index, along with any that were held
+// back waiting for it.
+static void finishBatchDeal(Batch* batch, unsigned long index,
+                            const BatchResult& result) {
+  lock_guard<mutex> lock(batch->outputMutex);
+  map<unsigned long, BatchResult>::iterator next;
+
+  batch->waiting[index] = result;
+  while ((next = batch->waiting.find(batch->dealsWritten)) != batch->waiting.end()) {
+    writeBatchResult(cout, next->second);
+    batch->results.push_back(next->second);
+    batch->waiting.erase(next);
+    batch->dealsWritten++;
+  }
+  cout.flush();
+}
+
+// writeBatchResult
+// One line of JSON. The ID is quoted, escaping whatever JSON needs escaped.
+static void writeBatchResult(ostream& out, const BatchResult& result) {
+  size_t i;
+
+  out << "{\"id\":\"";
+  for (i = 0; i < result.id.size(); i++) {
+    char c = result.id[i];
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    }
+    else if ((unsigned char)c < 0x20) {
+      out << ' ';
+    }
+    else {
+      out << c;
+    }
+  }
+  out << "\",\"status\":\"" << result.status << "\""
+      << ",\"moves\":" << result.moves
+      << ",\"nodes\":" << result.nodes
+      << ",\"pruned\":" << result.pruned
+      << ",\"generated\":" << result.generated
+      << ",\"max_depth\":" << result.maxDepth
+      << ",\"best_cards\":" << result.bestFoundationCards
+      << ",\"ms\":" << fixed << setprecision(3) << result.milliseconds
+      << ",\"cpu_ms\":" << result.cpuMilliseconds
+      << ",\"peak_table_bytes\":" << result.tableMemory << "}\n";
+}
+
+// writeBatchSummary
+// How many deals were solved and how fast, with percentiles of the time and
+// positions each deal took over the deals that were valid.
+static void writeBatchSummary(ostream& out, const vector<BatchResult>& results,
+                              double seconds, unsigned int threadCount) {
+  vector<double> times, nodes, moves;
+  size_t solved = 0, unsolved = 0, invalid = 0, i;
+
+  for (i = 0; i < results.size(); i++) {
+    const BatchResult& result = results[i];
+    if (strcmp(result.status, "invalid_deal") == 0) {
+      invalid++;
+      continue;
+    }
+    if (strcmp(result.status, "solved") == 0) {
+      solved++;
+      moves.push_back(result.moves);
+    }
+    else {
+      unsolved++;
+    }
+    times.push_back(result.milliseconds);
+    nodes.push_back(result.nodes);
+  }
+
+  out << fixed << setprecision(2);
+  out << "Solved " << solved << " of " << results.size() << " deals ("
+      << unsolved << " unsolved, " << invalid << " invalid) in " << seconds
+      << " s on " << threadCount << " threads, "
+      << (seconds > 0 ? results.size() / seconds : 0) << " deals/s" << endl;
+  if (times.empty()) {
+    return;
+  }
+  out << "ms per deal:   p50 " << percentile(&times, 0.5)
+      << "  p90 " << percentile(&times, 0.9)
+      << "  p99 " << percentile(&times, 0.99)
+      << "  max " << percentile(&times, 1) << endl;
+  out << setprecision(0);
+  out << "nodes per deal: p50 " << percentile(&nodes, 0.5)
+      << "  p90 " << percentile(&nodes, 0.9)
+      << "  p99 " << percentile(&nodes, 0.99)
+      << "  max " << percentile(&nodes, 1) << endl;
+  if (!moves.empty()) {
+    out << "moves per solution: p50 " << percentile(&moves, 0.5)
+        << "  p90 " << percentile(&moves, 0.9)
+        << "  max " << percentile(&moves, 1) << endl;
+  }
+}
+
+// percentile
+// The nearest-rank percentile of a nonempty set of values; sorts them.
+static double percentile(vector<double>* values, double fraction) {
+  size_t rank;
+
+  sort(values->begin(), values->end());
+  rank = (size_t)ceil(fraction * values->size());
+  if (rank > 0) {
+    rank--;
+  }
+  return (*values)[rank];
+}
+
+// printProgress
+// The progress callback for -r: one line on stderr per report.
+static void printProgress(const SolverProgress& progress, void* /*context*/) {
+  cerr << fixed << setprecision(1) << progress.elapsedTime << " s: "
+       << progress.nodesExpanded << " positions, " << setprecision(0)
+       << progress.nodesPerSecond << "/s, depth " << progress.depth << ", "
+       << progress.bestFoundationCards << " cards home at best, "
+       << progress.tableSize << " positions remembered" << endl;
 }
 
 
@@ -0,0 +1,100 @@
+// BucketQueue.h
+// A priority queue for small integer priorities.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef BUCKETQUEUE_H
+#define BUCKETQUEUE_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Keeps one list of values per priority, so push and pop are constant time
+ * apart from the occasional scan up to the next used priority. The lowest
+ * priority comes out first; values with the same priority come out last in,
+ * first out, which makes the search dive instead of widening.
+ **/
+class BucketQueue {
+public:
+  BucketQueue();
+
+  void push(unsigned int priority, uint32_t value);
+  // removes and returns a value with the lowest priority. The queue must not
+  // be empty.
+  uint32_t pop();
+
+  bool empty() const;
+  size_t size() const;
+  void clear();
+
+private:
+  std::vector<std::vector<uint32_t> > buckets;
+  unsigned int lowest; // no bucket below this one has anything in it
+  size_t count;
+};
+
+inline BucketQueue::BucketQueue()
+{
+  lowest = 0;
+  count = 0;
+}
+
+inline void BucketQueue::push(unsigned int priority, uint32_t value)
+{
+  if (priority >= buckets.size()) {
+    buckets.resize(priority + 1);
+  }
+  buckets[priority].push_back(value);
+  if (priority < lowest) {
+    lowest = priority;
+  }
+  count++;
+}
+
+inline uint32_t BucketQueue::pop()
+{
+  uint32_t value;
+
+  while (buckets[lowest].empty()) {
+    lowest++;
+  }
+  value = buckets[lowest].back();
+  buckets[lowest].pop_back();
+  count--;
+  return value;
+}
+
+inline bool BucketQueue::empty() const
+{
+  return count == 0;
+}
+
+inline size_t BucketQueue::size() const
+{
+  return count;
+}
+
+inline void BucketQueue::clear()
+{
+  buckets.clear();
+  lowest = 0;
+  count = 0;
+}
+
+#endif // BUCKETQUEUE_H
@@ -0,0 +1,176 @@
+// ColumnStore.cpp
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "ColumnStore.h"
+#include <new>
+
+using namespace std;
+
+enum {
+  kInitialSlots = 1 << 12,
+  kMaxColumns = 1 << 26
+};
+
+// the ID published in a shared slot whose tableau didn't fit
+const uint32_t kNoRoom = 0xFFFFFFFF;
+
+ColumnStore::ColumnStore()
+: slotCount(0), idCount(0), shared(false)
+{
+  clear();
+}
+
+ColumnStore::ColumnStore(size_t sharedCapacity)
+: slotCount(0), idCount(0), shared(true)
+{
+  size_t count = kInitialSlots;
+
+  // ID 0 always has to fit, and a store too small to get anywhere is no use
+  if (sharedCapacity < kInitialSlots) {
+    sharedCapacity = kInitialSlots;
+  }
+  if (sharedCapacity > kMaxColumns) {
+    sharedCapacity = kMaxColumns;
+  }
+  // stay at or under 3/4 full
+  while (count * 3 < sharedCapacity * 4) {
+    count *= 2;
+  }
+  parents.resize(sharedCapacity);
+  cards.resize(sharedCapacity);
+  allocateSlots(count);
+  // ID 0 is the empty tableau; it is its own parent
+  parents[0] = kEmptyColumn;
+  cards[0] = 0;
+  idCount = 1;
+}
+
+void ColumnStore::allocateSlots(size_t count)
+{
+  slots.reset(new atomic<uint64_t>[count]());
+  slotCount = count;
+}
+
+void ColumnStore::clear()
+{
+  if (shared) {
+    // other threads may be using it
+    return;
+  }
+  // ID 0 is the empty tableau; it is its own parent
+  parents.assign(1, kEmptyColumn);
+  cards.assign(1, 0);
+  allocateSlots(kInitialSlots);
+  idCount = 1;
+}
+
+ColumnId ColumnStore::push(ColumnId column, unsigned char card)
+{
+  if (shared) {
+    return pushShared(column, card);
+  }
+
+  uint32_t key = slotKey(column, card);
+  size_t mask = slotCount - 1;
+  size_t i = hashSlot(key) & mask;
+  uint64_t slot;
+
+  while ((slot = slots[i].load(memory_order_relaxed)) != 0) {
+    if (uint32_t(slot) == key) {
+      return ColumnId(slot >> 32);
+    }
+    i = (i + 1) & mask;
+  }
+
+  // a tableau we haven't seen before
+  if (parents.size() >= kMaxColumns) {
+    throw bad_alloc();
+  }
+  ColumnId id = ColumnId(parents.size());
+  parents.push_back(column);
+  cards.push_back(card);
+  slots[i].store((uint64_t(id) << 32) | key, memory_order_relaxed);
+  idCount.store(parents.size(), memory_order_relaxed);
+  // keep the load factor at or under 3/4
+  if (parents.size() * 4 > slotCount * 3) {
+    grow();
+  }
+  return id;
+}
+
+// The same lookup, safe against other threads pushing at the same time. A
+// new tableau is claimed by writing its key into an unused slot; the thread
+// that wins then takes the next ID, fills in the parent and card, and only
+// then publishes the ID, so a thread that gets an ID can always pop it.
+ColumnId ColumnStore::pushShared(ColumnId column, unsigned char card)
+{
+  uint32_t key = slotKey(column, card);
+  size_t mask = slotCount - 1;
+  size_t i = hashSlot(key) & mask;
+  uint64_t slot;
+
+  for (;;) {
+    slot = slots[i].load(memory_order_acquire);
+    if (slot == 0) {
+      if (slots[i].compare_exchange_strong(slot, key, memory_order_acquire)) {
+        size_t id = idCount.fetch_add(1, memory_order_relaxed);
+        if (id >= parents.size()) {
+          // out of IDs; let anyone waiting on this slot know too
+          slots[i].store((uint64_t(kNoRoom) << 32) | key, memory_order_release);
+          throw bad_alloc();
+        }
+        parents[id] = column;
+        cards[id] = card;
+        slots[i].store((uint64_t(id) << 32) | key, memory_order_release);
+        return ColumnId(id);
+      }
+      // somebody else just took the slot; slot is what they put there
+    }
+    if (uint32_t(slot) == key) {
+      // wait for the thread that claimed it to publish the ID
+      while ((slot >> 32) == 0) {
+        slot = slots[i].load(memory_order_acquire);
+      }
+      if ((slot >> 32) == kNoRoom) {
+        throw bad_alloc();
+      }
+      return ColumnId(slot >> 32);
+    }
+    i = (i + 1) & mask;
+  }
+}
+
+void ColumnStore::grow()
+{
+  unique_ptr<atomic<uint64_t>[]> oldSlots(slots.release());
+  size_t oldCount = slotCount;
+  size_t mask, i, j;
+  uint64_t slot;
+
+  allocateSlots(oldCount * 2);
+  mask = slotCount - 1;
+  for (i = 0; i < oldCount; i++) {
+    slot = oldSlots[i].load(memory_order_relaxed);
+    if (slot != 0) {
+      j = hashSlot(uint32_t(slot)) & mask;
+      while (slots[j].load(memory_order_relaxed) != 0) {
+        j = (j + 1) & mask;
+      }
+      slots[j].store(slot, memory_order_relaxed);
+    }
+  }
+}
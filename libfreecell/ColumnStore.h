@@ -0,0 +1,137 @@
+// ColumnStore.h
+// Gives every distinct tableau a small integer ID.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef COLUMNSTORE_H
+#define COLUMNSTORE_H
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t ColumnId;
+
+// the ID of an empty tableau
+const ColumnId kEmptyColumn = 0;
+
+/**
+ * An interning table for tableau contents. A tableau is identified by the
+ * tableau under its top card plus that card, so the IDs form a tree rooted at
+ * the empty tableau: placing a card is one lookup in a hash table, and
+ * removing one is an array read. Two tableaus with the same cards in the same
+ * order always get the same ID.
+ * Cards are given as codes 1..52.
+ * A store made with a capacity is shared: it never grows, and any number of
+ * threads may push to it at once, so games on different threads agree on
+ * every ID. Otherwise it grows as needed and belongs to one thread.
+ **/
+class ColumnStore {
+public:
+  ColumnStore();
+  // room for at least sharedCapacity tableaus, and never fewer than a few
+  // thousand
+  explicit ColumnStore(size_t sharedCapacity);
+
+  // the ID of the tableau made by placing card on top of column. Throws
+  // std::bad_alloc when a shared store is full.
+  ColumnId push(ColumnId column, unsigned char card);
+  // the ID of the tableau left when the top card is removed from column
+  ColumnId pop(ColumnId column) const;
+  unsigned char topCard(ColumnId column) const;
+
+  void clear();
+  bool isShared() const;
+  size_t size() const;
+  size_t memoryUsage() const;
+  // the memory the tableaus in the store take up; for a shared store, far
+  // less than memoryUsage until it fills
+  size_t usedMemory() const;
+
+private:
+  // not copyable
+  ColumnStore(const ColumnStore&);
+  ColumnStore& operator = (const ColumnStore&);
+
+  ColumnId pushShared(ColumnId column, unsigned char card);
+  void allocateSlots(size_t count);
+  static uint32_t slotKey(ColumnId parent, unsigned char card);
+  static size_t hashSlot(uint32_t key);
+  void grow();
+
+  // indexed by ColumnId; a shared store allocates all of them up front
+  std::vector<ColumnId> parents;
+  std::vector<unsigned char> cards;
+  // open addressing, power of two size, linear probing. A used slot holds
+  // the ID in its high 32 bits and slotKey in its low 32; 0 means unused.
+  // In a shared store a slot that has its key but no ID yet is being
+  // filled in by another thread.
+  std::unique_ptr<std::atomic<uint64_t>[]> slots;
+  size_t slotCount;
+  std::atomic<size_t> idCount;
+  bool shared;
+};
+
+inline ColumnId ColumnStore::pop(ColumnId column) const
+{
+  return parents[column];
+}
+
+inline unsigned char ColumnStore::topCard(ColumnId column) const
+{
+  return cards[column];
+}
+
+inline bool ColumnStore::isShared() const
+{
+  return shared;
+}
+
+inline size_t ColumnStore::size() const
+{
+  return idCount.load(std::memory_order_relaxed);
+}
+
+inline size_t ColumnStore::memoryUsage() const
+{
+  return parents.capacity() * sizeof(ColumnId) + cards.capacity() +
+         slotCount * sizeof(uint64_t);
+}
+
+inline size_t ColumnStore::usedMemory() const
+{
+  if (!shared) {
+    return memoryUsage();
+  }
+  return size() * (sizeof(ColumnId) + 1 + sizeof(uint64_t));
+}
+
+// IDs are limited to 26 bits so the parent and card fit in 32
+inline uint32_t ColumnStore::slotKey(ColumnId parent, unsigned char card)
+{
+  return (parent << 6) | card;
+}
+
+inline size_t ColumnStore::hashSlot(uint32_t key)
+{
+  uint64_t h = key * 0x9E3779B97F4A7C15ULL;
+  return size_t(h ^ (h >> 32));
+}
+
+#endif // COLUMNSTORE_H
@@ -0,0 +1,49 @@
+// CompactMove.h
+// A CardMove packed into 16 bits, for when the solver keeps lots of them.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef COMPACTMOVE_H
+#define COMPACTMOVE_H
+
+#include <stdint.h>
+#include "CardMove.h"
+#include "FreeCellGame.h"
+
+// bits 8-13 are the card index, 4-7 the origin and 0-3 the destination
+class CompactMove {
+public:
+  CompactMove() : bits(0) {}
+  CompactMove(const CardMove& move)
+  : bits(uint16_t((cardIndex(move.card) << 8) | (move.from << 4) | move.dest)) {}
+
+  CardMove toCardMove() const;
+
+private:
+  uint16_t bits;
+};
+
+inline CardMove CompactMove::toCardMove() const
+{
+  Card card;
+  int index = bits >> 8;
+  card.num = index % NUM_RANKS + 1;
+  card.suit = CardSuit(index / NUM_RANKS);
+  return CardMove(card, Location((bits >> 4) & 0xF), Location(bits & 0xF));
+}
+
+#endif // COMPACTMOVE_H
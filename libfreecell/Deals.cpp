@@ -0,0 +1,149 @@
+// Deals.cpp
+// Reads deals written the way the ANSI front end takes them.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <ctype.h>
+#include "Deals.h"
+#include "FreeCellGame.h"
+
+using namespace std;
+
+// parseTableau
+bool parseTableau(const char* description, Tableau* tableau) {
+  Card card;
+  char* end;
+  long rank;
+
+  if (*description == '\0') {
+    return false;
+  }
+  while (*description != '\0') {
+    rank = strtol(description, &end, 10);
+    if (end == description || rank < 1 || rank > HIGHEST_RANK) {
+      return false;
+    }
+    switch (toupper(*end)) {
+      case 'C':
+        card.suit = clubs;
+        break;
+      case 'D':
+        card.suit = diamonds;
+        break;
+      case 'H':
+        card.suit = hearts;
+        break;
+      case 'S':
+        card.suit = spades;
+        break;
+      default:
+        return false;
+    }
+    card.num = (unsigned short)rank;
+    tableau->place(card);
+    description = end + 1;
+  }
+  return true;
+}
+
+// parseDeal
+bool parseDeal(const string& line, vector<Tableau>* tableaus) {
+  istringstream words(line);
+  string word;
+  bool seen[NUM_CARDS] = {false};
+  int i, cards = 0;
+  size_t j;
+
+  tableaus->assign(NUM_TABLEAUS, Tableau());
+  for (i = 0; i < NUM_TABLEAUS; i++) {
+    if (!(words >> word) || !parseTableau(word.c_str(), &(*tableaus)[i])) {
+      return false;
+    }
+    for (j = 0; j < (*tableaus)[i].size(); j++) {
+      int index = cardIndex((*tableaus)[i].peek(j));
+      if (seen[index]) {
+        return false;
+      }
+      seen[index] = true;
+      cards++;
+    }
+  }
+  return cards == NUM_CARDS && !(words >> word);
+}
+
+// loadDeals
+bool loadDeals(const char* path, vector<vector<Tableau> >* deals, unsigned int* badLine) {
+  ifstream in(path);
+  string line;
+  vector<Tableau> tableaus;
+  unsigned int lineNumber = 0;
+  size_t start;
+
+  if (!in) {
+    return false;
+  }
+  while (getline(in, line)) {
+    lineNumber++;
+    start = line.find_first_not_of(" \t\r");
+    if (start == string::npos || line[start] == '#') {
+      continue;
+    }
+    if (!parseDeal(line, &tableaus)) {
+      if (badLine != NULL) {
+        *badLine = lineNumber;
+      }
+      return false;
+    }
+    deals->push_back(tableaus);
+  }
+  return true;
+}
+
+// getMicrosoftDeal
+// Microsoft's deals come from its C library's rand(): a linear congruential
+// generator seeded with the deal number, taking bits 16-30 of each step. The
+// deck starts in order, ace of clubs, ace of diamonds and so on up to the
+// king of spades; each card dealt, left to right across the tableaus, is
+// drawn from those left, and the last one left takes its place.
+bool getMicrosoftDeal(unsigned long number, vector<Tableau>* tableaus) {
+  const CardSuit suits[] = {clubs, diamonds, hearts, spades};
+  unsigned char deck[NUM_CARDS];
+  unsigned long seed = number;
+  int i, left, drawn;
+  Card card;
+
+  if (number == 0 || number > kLastDealNumber) {
+    return false;
+  }
+  for (i = 0; i < NUM_CARDS; i++) {
+    deck[i] = (unsigned char)i;
+  }
+  tableaus->assign(NUM_TABLEAUS, Tableau());
+  for (i = 0; i < NUM_CARDS; i++) {
+    left = NUM_CARDS - i;
+    seed = (seed * 214013 + 2531011) & 0x7fffffff;
+    drawn = int((seed >> 16) % left);
+    card.num = (unsigned short)(deck[drawn] / NUM_SUITS + 1);
+    card.suit = suits[deck[drawn] % NUM_SUITS];
+    deck[drawn] = deck[left - 1];
+    (*tableaus)[i % NUM_TABLEAUS].place(card);
+  }
+  return true;
+}
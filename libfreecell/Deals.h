@@ -0,0 +1,54 @@
+// Deals.h
+// Reads deals written the way the ANSI front end takes them.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef DEALS_H
+#define DEALS_H
+
+#include <string>
+#include <vector>
+#include "Tableau.h"
+
+// A tableau is its cards from the bottom up with nothing in between, each
+// the rank (1-13) followed by the suit (c, d, h or s): "1d5h13s" is the ace
+// of diamonds under the five of hearts under the king of spades.
+// Returns false if the description is empty or not made of cards; *tableau
+// gets the cards before the first bad one.
+bool parseTableau(const char* description, Tableau* tableau);
+
+// A deal is the eight tableau descriptions separated by spaces. Returns
+// false unless there are exactly eight, holding the 52 cards once each.
+bool parseDeal(const std::string& line, std::vector<Tableau>* tableaus);
+
+// Reads a file of deals, one per line; blank lines and lines starting with
+// '#' are skipped. Returns false if the file can't be read or a line isn't a
+// deal, with *badLine set to its number if badLine isn't NULL.
+bool loadDeals(const char* path, std::vector<std::vector<Tableau> >* deals,
+               unsigned int* badLine = NULL);
+
+enum {
+  kLastDealNumber = 0x7fffffff
+};
+
+// Deals the game Microsoft FreeCell numbers number into *tableaus. Numbers up
+// to 32000 are the original games, and up to 1000000 those FreeCell Pro
+// added the same way. Returns false for 0 and numbers past kLastDealNumber,
+// which the generator doesn't cover.
+bool getMicrosoftDeal(unsigned long number, std::vector<Tableau>* tableaus);
+
+#endif // DEALS_H
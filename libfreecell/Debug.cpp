@@ -1 +1 @@
-/* This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.  This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.  You should have received a copy of the GNU General Public License along with this program.  If not, see <http://www.gnu.org/licenses/>.  */#include "Debug.h"using namespace std;// Initialize the default Debug instance.Debug Debug::defaultInstance;Debug::Debug(){	enabled = false;	level = 0;}void Debug::print(const string& str){	if (enabled) {		*logstream << str << flush;	}}void Debug::print(int level, const string& str){	if (enabled && level >= this->level) {		*logstream << str << flush;	}}Debug& Debug::getDefaultInstance(){	return defaultInstance;}void Debug::setDebugStream(ostream& o){	logstream = &o;}Debug& Debug::operator <<(ostream& (*manip)(ostream&)){	if (enabled) {		*logstream << manip;	}	return *this;}
\ No newline at end of file
+/* This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.  This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.  You should have received a copy of the GNU General Public License along with this program.  If not, see <http://www.gnu.org/licenses/>.  */#include "Debug.h"#include <limits.h>using namespace std;// Initialize the default Debug instance.Debug Debug::defaultInstance;Debug::Debug(): enabled(false), level(kDebugTrace), threshold(INT_MAX), lineBuffer(&ring),  lineStream(&lineBuffer){}void Debug::setLevel(int level){	this->level = level;	if (enabled) {		threshold = level;	}}void Debug::enable(){	enabled = true;	threshold = level;}void Debug::disable(){	enabled = false;	threshold = INT_MAX;}void Debug::print(const string& str){	if (enabled) {		lineStream << str << std::flush;	}}void Debug::print(int level, const string& str){	if (isLogging(level)) {		lineStream << str << std::flush;	}}void Debug::flush(){	lineStream.flush();	ring.flush();}Debug& Debug::getDefaultInstance(){	return defaultInstance;}void Debug::setDebugStream(ostream& o){	lineBuffer.setStream(&o);}Debug& Debug::operator <<(ostream& (*manip)(ostream&)){	if (enabled) {		lineStream << manip;	}	return *this;}
\ No newline at end of file
@@ -1 +1 @@
-//// Debug.h// Flexible DebugLogging class// Julian Pellico/* This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.  This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.  You should have received a copy of the GNU General Public License along with this program.  If not, see <http://www.gnu.org/licenses/>.  */#ifndef __Debug_H__#define __Debug_H__#include <ostream>#include <iomanip>class Debug{public:	Debug();		bool isEnabled();	void setDebugStream(std::ostream& o);	void setLevel(int level);	void enable();	void disable();	void print(const std::string& str);	void print(int level, const std::string& str);	static Debug& getDefaultInstance();		template <typename T>	Debug& operator <<(const T& t);	Debug& operator <<(std::ostream& (*manip)(std::ostream&));	private:	bool enabled;	std::ostream* logstream;	int level;	static Debug defaultInstance;};inline bool Debug::isEnabled(){	return enabled;}inline void Debug::enable(){	enabled = true;}inline void Debug::disable(){	enabled = false;}template <typename T>Debug& Debug::operator <<(const T& t){	if (enabled) {		*logstream << t;	}	return *this;}#endif
\ No newline at end of file
+//// Debug.h// Flexible DebugLogging class// Julian Pellico/* This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.  This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more details.  You should have received a copy of the GNU General Public License along with this program.  If not, see <http://www.gnu.org/licenses/>.  */#ifndef __Debug_H__#define __Debug_H__#include <ostream>#include <iomanip>#include <string>#include "LogRing.h"// how much a message matters; a Debug logs the ones at or above its levelenum DebugLevel {	kDebugTrace,	// every move the searches make and skip	kDebugInfo,		// how each solve goes	kDebugError};// DEBUG_LOG leaves out the messages below this level altogether; build with// it raised to take the tracing out of the searches.#ifndef DEBUG_COMPILED_LEVEL#define DEBUG_COMPILED_LEVEL kDebugTrace#endif// true if debugger logs messages of the level#define DEBUG_ENABLED(debugger, level) \	((level) >= DEBUG_COMPILED_LEVEL && (debugger).isLogging(level))// Logs message, a chain of << operands, at the level. Unless it is logged,// nothing in the message is evaluated.#define DEBUG_LOG(debugger, level, message) \	do { \		if (DEBUG_ENABLED(debugger, level)) { \			(debugger) << message; \		} \	} while (0)/** * A log that can be turned on and off. While it is on, each line is * formatted into a buffer of the Debug's own and handed to a LogRing, whose * thread writes it to the stream, so logging never waits on a file. A Debug * is used from one thread at a time. Messages written with << go out * whenever it is on; DEBUG_LOG also heeds the level. **/class Debug{public:	Debug();		bool isEnabled();	// one compare, so it can guard logging on the hot paths	bool isLogging(int level) const;	// the stream must stay open until flush has been called	void setDebugStream(std::ostream& o);	void setLevel(int level);	void enable();	void disable();	void print(const std::string& str);	void print(int level, const std::string& str);	// waits until everything logged so far has reached the stream	void flush();	static Debug& getDefaultInstance();		template <typename T>	Debug& operator <<(const T& t);	Debug& operator <<(std::ostream& (*manip)(std::ostream&));	private:	Debug(const Debug&);	Debug& operator =(const Debug&);	bool enabled;	int level;	// the lowest level logged: level while enabled, and above them all while	// not	int threshold;	LogRing ring;	LogLineBuffer lineBuffer;	std::ostream lineStream;	static Debug defaultInstance;};inline bool Debug::isEnabled(){	return enabled;}inline bool Debug::isLogging(int level) const{	return level >= threshold;}template <typename T>Debug& Debug::operator <<(const T& t){	if (enabled) {		lineStream << t;	}	return *this;}#endif
\ No newline at end of file
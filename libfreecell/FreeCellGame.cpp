@@ -24,15 +24,38 @@
 #include "Solve FreeCell.h"
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <random>
 #include <assert.h>
 
 using namespace std;
 
 FreeCellGame::FreeCellGame()
 {
+  columns = &columnStore;
+  probing = false;
+  debugger = &Debug::getDefaultInstance();
+  autoPlayRule = kAutoPlayNone;
   reset(); // reset the instance
 }
 
+void FreeCellGame::setColumnStore(ColumnStore* store)
+{
+  columns = (store != NULL) ? store : &columnStore;
+  recalculateHashes();
+}
+
+void FreeCellGame::beginProbe()
+{
+  probing = true;
+}
+
+// the IDs were left as they were at beginProbe, which is where the game is
+void FreeCellGame::endProbe()
+{
+  probing = false;
+}
+
 /**
  * As well as copying the tableaus, setTableaus calculates the initial state
  * information that can be applied towards selecting good moves.
@@ -53,13 +76,17 @@ void FreeCellGame::setTableaus(const vector<Tableau>& tableaus)
     }
   }
 
+  recalculateHashes();
+  recalculateFeatures();
 }
 
 bool FreeCellGame::performMove(const CardMove& theMove)
 {
-  Debug& debugger = Debug::getDefaultInstance();
   bool validMove;
-  string debugMessage;
+  // what was wrong with an invalid move; literals, so a valid move costs
+  // nothing to describe
+  const char* invalidMove = NULL;
+  const char* invalidReason = "";
 
   if (theMove.from >= tableau1) {
     if (theMove.dest == foundation) {
@@ -67,86 +94,106 @@ bool FreeCellGame::performMove(const CardMove& theMove)
       validMove = (tableaus[locToTableau(theMove.from)].size() > 0 &&
                    foundationRanks[theMove.card.suit] == theMove.card.num - 1);
       if (!validMove) {
-        debugMessage = "Invalid move (tableau => foundation): ";
+        invalidMove = "Invalid move (tableau => foundation)";
         if (tableaus[locToTableau(theMove.from)].size() == 0)
-          debugMessage += "tried to move a card from a tableau that was empty";
+          invalidReason = "tried to move a card from a tableau that was empty";
         else
-          debugMessage += "tried to move a card to foundation that wasn't the required card";
+          invalidReason = "tried to move a card to foundation that wasn't the required card";
       }
       foundationRanks[theMove.card.suit]++;
-      tableaus[locToTableau(theMove.from)].removeTop();
+      removeFromTableau(locToTableau(theMove.from));
     }
     else if (theMove.dest >= tableau1) {
-      validMove = (tableaus[locToTableau(theMove.from)].size() > 0 &&
-                   (tableaus[locToTableau(theMove.dest)].size() == 0 ||
-                    canPlaceOnTop(theMove.card, tableaus[locToTableau(theMove.dest)].top()) ));
-      if (!validMove) {
-        debugMessage = "Invalid move (tableau => tableau): ";
-        if (tableaus[locToTableau(theMove.from)].size() == 0)
-          debugMessage += "tried to move a card from a tableau that was empty";
-        else
-          debugMessage += "tried to move a card on top of a card that it can't be placed on";
+      const Tableau& fromTableau = tableaus[locToTableau(theMove.from)];
+      const Tableau& destTableau = tableaus[locToTableau(theMove.dest)];
+      int depth = depthInTableau(locToTableau(theMove.from), theMove.card);
+      if (depth > 0) {
+        // a run move: every card above the moved one has to stack on the one below
+        validMove = (depth + 1 <= getRunLimit(destTableau.empty()) &&
+                     (destTableau.empty() || canPlaceOnTop(theMove.card, destTableau.top())));
+        for (int i = 0; validMove && i < depth; i++) {
+          validMove = canPlaceOnTop(fromTableau.peek(fromTableau.size() - 1 - i),
+                                    fromTableau.peek(fromTableau.size() - 2 - i));
+        }
+        if (!validMove) {
+          invalidMove = "Invalid move (tableau => tableau)";
+          invalidReason = "tried to move a run of cards that can't be moved there";
+        }
+        moveRun(locToTableau(theMove.from), locToTableau(theMove.dest), depth + 1);
+      }
+      else {
+        validMove = (fromTableau.size() > 0 &&
+                     (destTableau.size() == 0 ||
+                      canPlaceOnTop(theMove.card, destTableau.top()) ));
+        if (!validMove) {
+          invalidMove = "Invalid move (tableau => tableau)";
+          if (fromTableau.size() == 0)
+            invalidReason = "tried to move a card from a tableau that was empty";
+          else
+            invalidReason = "tried to move a card on top of a card that it can't be placed on";
+        }
+        placeOnTableau(locToTableau(theMove.dest), theMove.card);
+        removeFromTableau(locToTableau(theMove.from));
       }
-      tableaus[locToTableau(theMove.dest)].place(theMove.card);
-      tableaus[locToTableau(theMove.from)].removeTop();
     }
     else { // tableau =>free cell
       validMove = (tableaus[locToTableau(theMove.from)].size() > 0 && freeCells.countUsedCells() < NUM_FREE_CELLS);
       if (!validMove) {
-        debugMessage = "Invalid move (tableau => cell): ";
+        invalidMove = "Invalid move (tableau => cell)";
         if (tableaus[locToTableau(theMove.from)].size() == 0)
-          debugMessage += "tried to move a card from a tableau that was empty";
+          invalidReason = "tried to move a card from a tableau that was empty";
         else
-          debugMessage += "tried to move a card to a free cell when all cells were full";
+          invalidReason = "tried to move a card to a free cell when all cells were full";
       }
-      freeCells.add(theMove.card);
-      tableaus[locToTableau(theMove.from)].removeTop();
+      addToFreeCells(theMove.card);
+      removeFromTableau(locToTableau(theMove.from));
     }
   }
   // theMove.from == cell
   else if (theMove.dest >= tableau1) {
-    bool cellsHadCard = freeCells.remove(theMove.card);
+    bool cellsHadCard = removeFromFreeCells(theMove.card);
     validMove = (cellsHadCard &&
                  ( tableaus[locToTableau(theMove.dest)].size() == 0 ||
                    canPlaceOnTop(theMove.card, tableaus[locToTableau(theMove.dest)].top()) ));
     if (!validMove) {
-      debugMessage = "Invalid move (cell => tableau): ";
+      invalidMove = "Invalid move (cell => tableau)";
       if (!cellsHadCard)
-        debugMessage += "Tried to move a card from a free cell when that card wasn't there";
+        invalidReason = "Tried to move a card from a free cell when that card wasn't there";
       else
-        debugMessage += "tried to move a card on top of a card that it can't be placed on";
+        invalidReason = "tried to move a card on top of a card that it can't be placed on";
     }
-    tableaus[locToTableau(theMove.dest)].place(theMove.card);
+    placeOnTableau(locToTableau(theMove.dest), theMove.card);
   }
   else { // (theMove.dest == foundation)
-    bool cellsHadCard = freeCells.remove(theMove.card);
+    bool cellsHadCard = removeFromFreeCells(theMove.card);
     validMove = (cellsHadCard && foundationRanks[theMove.card.suit] == theMove.card.num - 1);
     if (!validMove) {
-      debugMessage = "Invalid move (cell => foundation): ";
+      invalidMove = "Invalid move (cell => foundation)";
       if (!cellsHadCard)
-        debugMessage += "Tried to move a card from a free cell when that card wasn't there";
+        invalidReason = "Tried to move a card from a free cell when that card wasn't there";
       else
-        debugMessage += "tried to move a card to foundation that wasn't the required card";
+        invalidReason = "tried to move a card to foundation that wasn't the required card";
     }
     foundationRanks[theMove.card.suit]++;
   }
   if (!validMove) {
-    debugger << debugMessage << endl;
+    DEBUG_LOG(*debugger, kDebugError, invalidMove << ": " << invalidReason << endl);
   }
 
   // update the location for the moved card
   locationsByCard[theMove.card.suit][theMove.card.num] = theMove.dest;
+  updateNextCards();
 
   // log relevant message for move
-  if (debugger.isEnabled()) {
+  if (DEBUG_ENABLED(*debugger, kDebugTrace)) {
     char *suitname, *fromname, *destname;
     suitString(&suitname, theMove.card.suit);
     locString(&destname, theMove.dest);
     locString(&fromname, theMove.from);
-    debugger << "Moved the " << theMove.card.num << " of "
+    *debugger << "Moved the " << theMove.card.num << " of "
       << suitname << " from " << fromname << " to " << destname << endl;
     if (theMove.dest == foundation)
-      debugger << "Moving to foundation, now "
+      *debugger << "Moving to foundation, now "
         << foundationRanks[clubs] + foundationRanks[hearts] + foundationRanks[diamonds] + foundationRanks[spades]
         << " cards on foundations" << endl;
   }
@@ -157,41 +204,273 @@ bool FreeCellGame::performMove(const CardMove& theMove)
 
 void FreeCellGame::undoMove(const CardMove& theMove)
 {
-  if (Debug::getDefaultInstance().isEnabled()) {
+  if (DEBUG_ENABLED(*debugger, kDebugTrace)) {
     char *suitname, *fromname, *destname;
     suitString(&suitname, theMove.card.suit);
     locString(&destname, theMove.dest);
     locString(&fromname, theMove.from);
-    Debug::getDefaultInstance() << "Unmoved the " << theMove.card.num << " of "
+    *debugger << "Unmoved the " << theMove.card.num << " of "
       << suitname << " from " << destname << " back to " << fromname << endl;
   }
 
   if (theMove.from >= tableau1) {
     if (theMove.dest == foundation) {
       foundationRanks[theMove.card.suit]--;
-      tableaus[locToTableau(theMove.from)].place(theMove.card);
+      placeOnTableau(locToTableau(theMove.from), theMove.card);
     }
     else if (theMove.dest >= tableau1) {
-      tableaus[locToTableau(theMove.dest)].removeTop();
-      tableaus[locToTableau(theMove.from)].place(theMove.card);
+      int depth = depthInTableau(locToTableau(theMove.dest), theMove.card);
+      if (depth > 0) {
+        moveRun(locToTableau(theMove.dest), locToTableau(theMove.from), depth + 1);
+      }
+      else {
+        removeFromTableau(locToTableau(theMove.dest));
+        placeOnTableau(locToTableau(theMove.from), theMove.card);
+      }
     }
     else { // undo tableau => free cell
-      freeCells.remove(theMove.card);
-      tableaus[locToTableau(theMove.from)].place(theMove.card);
+      removeFromFreeCells(theMove.card);
+      placeOnTableau(locToTableau(theMove.from), theMove.card);
     }
   }
   // undo cell => tableau
   else if (theMove.dest >= tableau1) {
-    tableaus[locToTableau(theMove.dest)].removeTop();
-    freeCells.add(theMove.card);
+    removeFromTableau(locToTableau(theMove.dest));
+    addToFreeCells(theMove.card);
   }
   else { // undo cell => foundation
     foundationRanks[theMove.card.suit]--;
-    freeCells.add(theMove.card);
+    addToFreeCells(theMove.card);
   }
 
   // update the location for the unmoved card
   locationsByCard[theMove.card.suit][theMove.card.num] = theMove.from;
+  updateNextCards();
+}
+
+// Random numbers for the position hash. They come from a fixed seed so that
+// hashes are the same from run to run.
+struct ZobristTables {
+  uint64_t tableau[NUM_CARDS][NUM_CARDS]; // [card][height above the bottom]
+  uint64_t freeCell[NUM_CARDS];
+
+  ZobristTables() {
+    uint64_t state = 0x2004073046726565ULL;
+    int i, j;
+    for (i = 0; i < NUM_CARDS; i++) {
+      for (j = 0; j < NUM_CARDS; j++) {
+        tableau[i][j] = scramble(state += 0x9E3779B97F4A7C15ULL);
+      }
+      freeCell[i] = scramble(state += 0x9E3779B97F4A7C15ULL);
+    }
+  }
+  // the splitmix64 finalizer: a bijection that maps 0 to 0
+  static uint64_t scramble(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+};
+
+static const ZobristTables& zobrist()
+{
+  static ZobristTables tables;
+  return tables;
+}
+
+void FreeCellGame::placeOnTableau(int tableau, const Card& card)
+{
+  uint64_t& tableauHash = tableauHashes[tableau];
+  positionHash -= ZobristTables::scramble(tableauHash);
+  tableauHash ^= zobrist().tableau[cardIndex(card)][tableaus[tableau].size()];
+  positionHash += ZobristTables::scramble(tableauHash);
+  if (!probing) {
+    columnIds[tableau] = columns->push(columnIds[tableau], cardIndex(card) + 1);
+  }
+
+  int height = int(tableaus[tableau].size());
+  cardHeights[cardIndex(card)] = (unsigned char)height;
+  if (height == 0) {
+    runLengths[tableau][0] = 1;
+    emptyTableaus--;
+  }
+  else if (canPlaceOnTop(card, tableaus[tableau].top())) {
+    runLengths[tableau][height] = runLengths[tableau][height - 1] + 1;
+  }
+  else {
+    runLengths[tableau][height] = 1;
+  }
+  tableaus[tableau].place(card);
+}
+
+void FreeCellGame::removeFromTableau(int tableau)
+{
+  uint64_t& tableauHash = tableauHashes[tableau];
+  if (tableaus[tableau].empty()) {
+    return;
+  }
+  const Card& card = tableaus[tableau].top();
+  positionHash -= ZobristTables::scramble(tableauHash);
+  tableauHash ^= zobrist().tableau[cardIndex(card)][tableaus[tableau].size() - 1];
+  positionHash += ZobristTables::scramble(tableauHash);
+  if (!probing) {
+    columnIds[tableau] = columns->pop(columnIds[tableau]);
+  }
+  tableaus[tableau].removeTop();
+  if (tableaus[tableau].empty()) {
+    emptyTableaus++;
+  }
+}
+
+int FreeCellGame::playAutoMoves(vector<CardMove>* played)
+{
+  CardMove move(Card(), cell, foundation);
+  int count = 0;
+
+  while (findAutoMove(&move)) {
+    performMove(move);
+    played->push_back(move);
+    count++;
+  }
+  return count;
+}
+
+void FreeCellGame::undoAutoMoves(vector<CardMove>* played, int count)
+{
+  for (; count > 0; count--) {
+    undoMove(played->back());
+    played->pop_back();
+  }
+}
+
+// findAutoMove
+// Looks for a card on top of a tableau or in a free cell that the auto play
+// rule sends to the foundations.
+bool FreeCellGame::findAutoMove(CardMove* move) const
+{
+  int i;
+
+  if (autoPlayRule == kAutoPlayNone) {
+    return false;
+  }
+  for (i = 0; i < NUM_TABLEAUS; i++) {
+    if (!tableaus[i].empty() && isAutoPlayable(tableaus[i].top())) {
+      *move = CardMove(tableaus[i].top(), tableauToLoc(i), foundation);
+      return true;
+    }
+  }
+  for (i = 0; i < freeCells.countUsedCells(); i++) {
+    if (isAutoPlayable(freeCells.get(i))) {
+      *move = CardMove(freeCells.get(i), cell, foundation);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FreeCellGame::isAutoPlayable(const Card& card) const
+{
+  int suit;
+
+  if (foundationRanks[card.suit] != card.num - 1) {
+    return false;
+  }
+  if (autoPlayRule == kAutoPlayAces) {
+    return card.num == 1;
+  }
+  for (suit = 0; suit < NUM_SUITS; suit++) {
+    Card other;
+    other.suit = CardSuit(suit);
+    if (!card.hasSuitOfSameColorAs(other) && foundationRanks[suit] < card.num - 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void FreeCellGame::moveRun(int from, int dest, int count)
+{
+  Card run[NUM_CARDS];
+  int i;
+
+  for (i = count - 1; i >= 0; i--) {
+    run[i] = tableaus[from].top();
+    removeFromTableau(from);
+  }
+  for (i = 0; i < count; i++) {
+    placeOnTableau(dest, run[i]);
+    locationsByCard[run[i].suit][run[i].num] = tableauToLoc(dest);
+  }
+}
+
+int FreeCellGame::depthInTableau(int tableau, const Card& card) const
+{
+  const Tableau& t = tableaus[tableau];
+  int i;
+
+  for (i = int(t.size()) - 1; i >= 0; i--) {
+    if (t.peek(i) == card) {
+      return int(t.size()) - 1 - i;
+    }
+  }
+  return -1;
+}
+
+int FreeCellGame::getRunLimit(bool toEmptyTableau) const
+{
+  int usableTableaus = emptyTableaus;
+
+  if (toEmptyTableau && usableTableaus > 0) {
+    usableTableaus--;
+  }
+  return (NUM_FREE_CELLS - freeCells.countUsedCells() + 1) << usableTableaus;
+}
+
+bool FreeCellGame::addToFreeCells(const Card& card)
+{
+  if (!freeCells.add(card)) {
+    return false;
+  }
+  positionHash -= freeCellHash;
+  freeCellHash ^= zobrist().freeCell[cardIndex(card)];
+  positionHash += freeCellHash;
+  return true;
+}
+
+bool FreeCellGame::removeFromFreeCells(const Card& card)
+{
+  if (!freeCells.remove(card)) {
+    return false;
+  }
+  positionHash -= freeCellHash;
+  freeCellHash ^= zobrist().freeCell[cardIndex(card)];
+  positionHash += freeCellHash;
+  return true;
+}
+
+// compute the hashes and column IDs from scratch
+void FreeCellGame::recalculateHashes()
+{
+  size_t i, j;
+
+  positionHash = 0;
+  for (i = 0; i < NUM_TABLEAUS; i++) {
+    tableauHashes[i] = 0;
+    columnIds[i] = kEmptyColumn;
+    if (i < tableaus.size()) {
+      for (j = 0; j < tableaus[i].size(); j++) {
+        const Card& card = tableaus[i].peek(j);
+        tableauHashes[i] ^= zobrist().tableau[cardIndex(card)][j];
+        columnIds[i] = columns->push(columnIds[i], cardIndex(card) + 1);
+      }
+    }
+    positionHash += ZobristTables::scramble(tableauHashes[i]);
+  }
+  freeCellHash = 0;
+  for (i = 0; i < freeCells.countUsedCells(); i++) {
+    freeCellHash ^= zobrist().freeCell[cardIndex(freeCells.get(i))];
+  }
+  positionHash += freeCellHash;
 }
 
 // check to see if all the foundations have the highest card (king)
@@ -204,29 +483,54 @@ bool FreeCellGame::gameIsSolved()
 }
 
 // update the elements in tableauIndicesForNextCardInSuit and
-// depthsForNextCardInSuit for a given suit.
-/*
- void FreeCellGame::updateDataForSuit(CardSuit suit)
- {
-   // preset it to a non-tableau location
-   tableauIndicesForNextCardInSuit[suit] = -1;
-   depthsForNextCardInSuit[suit] = -1;
-
-   int i, j;
-   for (i = 0; i < tableaus.size(); i++) {
-     const Tableau& tableau = tableaus[i];
-     for (j = 0; j < tableau.size(); j++) {
-       const Card& card = tableau.peek(j);
-       // if the card's rank matches what goes next on its suit's foundation
-       if (suit == card.suit && card.num == foundationRanks[suit] + 1) {
-         tableauIndicesForNextCardInSuit[suit] = i;
-         // the highest index is the top card of the tableau
-         depthsForNextCardInSuit[suit] = tableau.size() - j - 1;
-       }
-     }
-   }
- }
- */
+// depthsForNextCardInSuit, and the preferred origins, for every suit. Each
+// card knows where it is and how high up, so this doesn't scan anything.
+void FreeCellGame::updateNextCards()
+{
+  int suit;
+
+  preferredOriginMask = 0;
+  for (suit = 0; suit < NUM_SUITS; suit++) {
+    // preset it to a non-tableau location
+    tableauIndicesForNextCardInSuit[suit] = -1;
+    depthsForNextCardInSuit[suit] = -1;
+    if (foundationRanks[suit] < HIGHEST_RANK) {
+      int rank = foundationRanks[suit] + 1;
+      Location loc = locationsByCard[suit][rank];
+      preferredOriginMask |= locationBit(loc);
+      if (isLocTableau(loc)) {
+        int tableau = locToTableau(loc);
+        tableauIndicesForNextCardInSuit[suit] = tableau;
+        depthsForNextCardInSuit[suit] = int(tableaus[tableau].size()) - 1 -
+          cardHeights[suit * NUM_RANKS + rank - 1];
+      }
+    }
+  }
+}
+
+void FreeCellGame::recalculateFeatures()
+{
+  size_t i, j;
+
+  emptyTableaus = NUM_TABLEAUS;
+  for (i = 0; i < tableaus.size(); i++) {
+    const Tableau& tableau = tableaus[i];
+    if (!tableau.empty()) {
+      emptyTableaus--;
+    }
+    for (j = 0; j < tableau.size(); j++) {
+      const Card& card = tableau.peek(j);
+      cardHeights[cardIndex(card)] = (unsigned char)j;
+      if (j > 0 && canPlaceOnTop(card, tableau.peek(j - 1))) {
+        runLengths[i][j] = runLengths[i][j - 1] + 1;
+      }
+      else {
+        runLengths[i][j] = 1;
+      }
+    }
+  }
+  updateNextCards();
+}
 
 void FreeCellGame::reset()
 {
@@ -236,16 +540,37 @@ void FreeCellGame::reset()
   }
   freeCells.clear();
   tableaus.clear();
-  for (i = 0; i < NUM_FOUNDATIONS; i++) {
-    tableauIndicesForNextCardInSuit[i] = -1;
-    depthsForNextCardInSuit[i] = -1;
-  }
+  columnStore.clear();
+  probing = false;
+  recalculateHashes();
   for (i = 0; i < NUM_SUITS; i++) {
-    for (j = 0; j < HIGHEST_RANK; j++) {
+    for (j = 0; j <= HIGHEST_RANK; j++) {
       // default the location to somewhere not in the game
       locationsByCard[i][j] = deck;
     }
   }
+  recalculateFeatures();
+}
+
+void FreeCellGame::getStateKey(StateKey* key) const
+{
+  unsigned short usedCells = freeCells.countUsedCells();
+  int i;
+
+  for (i = 0; i < NUM_TABLEAUS; i++) {
+    key->columns[i] = columnIds[i];
+  }
+  sort(key->columns, key->columns + NUM_TABLEAUS);
+
+  // highest code first so the empty cells come last
+  for (i = 0; i < NUM_FREE_CELLS; i++) {
+    key->freeCells[i] = (i < usedCells ? cardIndex(freeCells.get(i)) + 1 : 0);
+  }
+  sort(key->freeCells, key->freeCells + NUM_FREE_CELLS, greater<unsigned char>());
+
+  for (i = 0; i < NUM_FOUNDATIONS; i++) {
+    key->foundations[i] = foundationRanks[i];
+  }
 }
 
 /**
@@ -267,30 +592,51 @@ set<Location> FreeCellGame::getPreferredMoveOrigins()
 set<Location> FreeCellGame::getPreferredMoveDestinations()
 {
   size_t i;
-  static set<Location>* tableauDestinations = NULL;
-  if (tableauDestinations == NULL) {
-    tableauDestinations = new set<Location>;
-    for (i = 0; i < NUM_TABLEAUS; i++) {
-      tableauDestinations->insert(tableauToLoc(i));
-    }
-  }
+  // built once, safely even when several solvers start at the same time
+  static const Location tableauLocations[NUM_TABLEAUS] = {
+    tableau1, tableau2, tableau3, tableau4, tableau5, tableau6, tableau7, tableau8
+  };
+  static const set<Location> tableauDestinations(tableauLocations,
+                                                 tableauLocations + NUM_TABLEAUS);
 
-  set<Location> destinations = *tableauDestinations;
+  set<Location> destinations = tableauDestinations;
   for (i = 0; i < NUM_SUITS; i++) {
     destinations.erase(locationsByCard[i][foundationRanks[i] + 1]);
   }
   return destinations;
 }
 
+unsigned int FreeCellGame::getPreferredMoveDestinationMask() const
+{
+  unsigned int mask = 0;
+  int i;
+
+  for (i = 0; i < NUM_TABLEAUS; i++) {
+    mask |= locationBit(tableauToLoc(i));
+  }
+  // every tableau except those holding the next card for a foundation
+  return mask & ~preferredOriginMask;
+}
+
 /**
  * Destroys contents of *setup and places a new random setup there.
  **/
 void FreeCellGame::getRandomSetup(vector<Tableau>* setup)
+{
+  getRandomSetup(setup, (unsigned int)rand());
+}
+
+/**
+ * Shuffles with minstd_rand rather than rand(), whose sequence differs from
+ * one C library to the next, so a seed names the same deal everywhere.
+ **/
+void FreeCellGame::getRandomSetup(vector<Tableau>* setup, unsigned int seed)
 {
   vector<Card> cards;
   int i, j, randCard;
   unsigned int cardsPerTableau;
   const CardSuit suits[] = {clubs, diamonds, hearts, spades};
+  minstd_rand random(seed);
 
   setup->clear();
   setup->resize(NUM_TABLEAUS);
@@ -314,7 +660,7 @@ void FreeCellGame::getRandomSetup(vector<Tableau>* setup)
       cardsPerTableau = 6;
     }
     for (j = 0; j < cardsPerTableau; j++) {
-      randCard = randInRange(0, cards.size() - 1);
+      randCard = int(random() % cards.size());
       setup->at(i).place(cards[randCard]);
       cards.erase(cards.begin() + randCard, cards.begin() + randCard + 1);
     }
@@ -377,14 +723,16 @@ void FreeCellGame::finishSetupRandomly(vector<Tableau>* setup)
  * that are the next cards required on foundation for each suit. Then this method returns the depth of the topmost
  * card of that set on tableau tableauIndex, or -1 if no card from that set is on that tableau.
  **/
-int FreeCellGame::depthOfNextFoundationCardForTableau(int tableauIndex)
+int FreeCellGame::depthOfNextFoundationCardForTableau(int tableauIndex) const
 {
-  int i;
-  for (i = tableaus[tableauIndex].size() - 1; i >= 0; i--) {
-    const Card& card = tableaus[tableauIndex].peek(i);
-    if (card.num == foundationRanks[card.suit] + 1) {
-      return tableaus[tableauIndex].size() - i - 1;
+  int depth = -1;
+  int suit;
+
+  for (suit = 0; suit < NUM_SUITS; suit++) {
+    if (tableauIndicesForNextCardInSuit[suit] == tableauIndex &&
+        (depth < 0 || depthsForNextCardInSuit[suit] < depth)) {
+      depth = depthsForNextCardInSuit[suit];
     }
   }
-  return -1;
+  return depth;
 }
@@ -25,11 +25,15 @@
 #include <vector>
 #include <set>
 #include <stdlib.h>
+#include <stdint.h>
 #include "Tableau.h"
 #include "CardMove.h"
 #include "FreeCells.h"
 #include "Card.h"
 #include "Location.h"
+#include "StateKey.h"
+#include "ColumnStore.h"
+#include "Debug.h"
 
 const int NUM_TABLEAUS = 8;
 const int NUM_FREE_CELLS = 4;
@@ -40,25 +44,86 @@ const int HIGHEST_RANK = 13;
 const int NUM_RANKS = 13;
 const int MAX_CARDS_PER_TABLEAU = 7;
 
+// which foundation moves playAutoMoves makes by itself
+enum AutoPlayRule {
+  kAutoPlayNone,
+  kAutoPlayAces,
+  // a card can go up once both cards of the other colour one rank below it
+  // are on the foundations; nothing could ever be stacked on it after that
+  kAutoPlaySafe
+};
+
 class FreeCellGame {
 public:
   FreeCellGame();
   void setTableaus(const std::vector<Tableau>& tableaus);
   // return true if the move is valid for the current state; false otherwise; always "performs" the move.
+  // A tableau to tableau move whose card is not the top card moves that card
+  // and everything on top of it, as long as it is a properly stacked run no
+  // longer than getRunLimit allows.
   bool performMove(const CardMove& move);
   // undoes the move without checking if the reverse move is valid, since it
   // won't necessarily be.
   void undoMove(const CardMove& move);
   void reset();
 
+  // Plays every card the auto play rule allows to the foundations, over and
+  // over until none is left, and adds the moves to played. Returns how many
+  // were played. undoAutoMoves takes the last count of them back off played
+  // and undoes them, so the chain can be undone as a unit.
+  int playAutoMoves(std::vector<CardMove>* played);
+  void undoAutoMoves(std::vector<CardMove>* played, int count);
+  // kAutoPlayNone, the default, leaves every move to the caller
+  void setAutoPlayRule(AutoPlayRule rule);
+
   std::set<Tableau> getTableauSet();
   const std::vector<Tableau>& getTableaus();
   std::set<Card> getFreeCellSet();
   const FreeCells& getFreeCells();
+  // fills in the canonical encoding of the current position; positions that
+  // differ only in the order of the tableaus or free cells get the same key.
+  void getStateKey(StateKey* key) const;
+  // a Zobrist hash of the current position, kept up to date by performMove
+  // and undoMove. Like the state key, it does not depend on the order of the
+  // tableaus or free cells.
+  uint64_t getPositionHash() const;
+  // Have the game take its tableau IDs from store, which must outlive it, so
+  // that games on several threads can share state keys. NULL goes back to
+  // the game's own store.
+  void setColumnStore(ColumnStore* store);
+  // the memory held by the store the game takes its tableau IDs from
+  size_t getColumnMemoryUsage() const;
+  size_t getColumnUsedMemory() const;
+  // Between beginProbe and endProbe, moves leave the tableau IDs alone, so
+  // they add nothing to the column store, and getStateKey means nothing.
+  // For looking a few moves ahead and back again: by endProbe the game has
+  // to be back where beginProbe found it.
+  void beginProbe();
+  void endProbe();
+  // Have the game log its moves to debugger, which must outlive it. NULL goes
+  // back to Debug's default instance.
+  void setDebug(Debug* debugger);
 
   std::set<Location> getPreferredMoveOrigins();
   std::set<Location> getPreferredMoveDestinations();
-  int depthOfNextFoundationCardForTableau(int tableau);
+  // the same as the two sets above, as masks of locationBit(location), which
+  // the move generator can test without building a set for every position
+  unsigned int getPreferredMoveOriginMask() const;
+  unsigned int getPreferredMoveDestinationMask() const;
+  // how many cards cover the topmost card in the tableau that could go to a
+  // foundation next, or -1 if there isn't one
+  int depthOfNextFoundationCardForTableau(int tableau) const;
+  // how many cards cover the next card for the suit's foundation, or -1 if
+  // it isn't on a tableau
+  int depthOfNextCardInSuit(CardSuit suit) const;
+  // the number of cards at the top of the tableau that are stacked in order,
+  // each on one of the other colour a rank higher; 0 if the tableau is empty
+  int getRunLength(int tableau) const;
+  int countEmptyTableaus() const;
+  // how many cards can be moved from tableau to tableau at once, using the
+  // free cells and empty tableaus: (free cells + 1) * 2^(empty tableaus). A
+  // move to an empty tableau can't use that tableau, so it gets half.
+  int getRunLimit(bool toEmptyTableau) const;
 
   bool gameIsSolved();
 
@@ -66,10 +131,29 @@ public:
 
   // a class utility method available to the public, to get a random game setup.
   static void getRandomSetup(std::vector<Tableau>* setup);
+  // the same setup every time for the same seed, on every platform
+  static void getRandomSetup(std::vector<Tableau>* setup, unsigned int seed);
   static void finishSetupRandomly(std::vector<Tableau>* setup);
 
 private:
   // methods
+  // every change to the tableaus and free cells goes through these, so the
+  // position hash stays current.
+  void placeOnTableau(int tableau, const Card& card);
+  void removeFromTableau(int tableau);
+  // moves the top count cards of one tableau onto another, keeping their order
+  void moveRun(int from, int dest, int count);
+  // how far from the top of the tableau the card is, or -1 if it isn't there
+  int depthInTableau(int tableau, const Card& card) const;
+  bool addToFreeCells(const Card& card);
+  bool removeFromFreeCells(const Card& card);
+  void recalculateHashes();
+  // the features below are kept up to date move by move as well; these set
+  // them up from scratch
+  void recalculateFeatures();
+  void updateNextCards();
+  bool isAutoPlayable(const Card& card) const;
+  bool findAutoMove(CardMove* move) const;
 
   // data
   FreeCells freeCells;
@@ -85,9 +169,81 @@ private:
   // the next 2 arrays use -1 to indicate the card is not on a tableau.
   int tableauIndicesForNextCardInSuit[NUM_SUITS];
   int depthsForNextCardInSuit[NUM_SUITS]; // top card has depth zero
-  
+  // locationBit of where each suit's next card is
+  unsigned int preferredOriginMask;
+  // how far up its tableau each card is, by cardIndex; the bottom card is 0.
+  // Only meaningful while the card is on a tableau.
+  unsigned char cardHeights[NUM_CARDS];
+  // the length of the ordered run ending at each height of each tableau
+  unsigned char runLengths[NUM_TABLEAUS][NUM_CARDS];
+  int emptyTableaus;
+
+  // the hash of each tableau is the XOR of a random number per (card, height)
+  // pair. The position hash adds up a scrambled copy of each of those, so
+  // swapping tableaus doesn't change it, and the free cell hash, which is the
+  // XOR of a random number per card in the free cells.
+  uint64_t tableauHashes[NUM_TABLEAUS];
+  uint64_t freeCellHash;
+  uint64_t positionHash;
+
+  // every tableau's ID in columns, also kept up to date move by move.
+  // columns is columnStore unless setColumnStore says otherwise.
+  ColumnStore columnStore;
+  ColumnStore* columns;
+  ColumnId columnIds[NUM_TABLEAUS];
+  bool probing;
+
+  // where performMove and undoMove log
+  Debug* debugger;
+
+  AutoPlayRule autoPlayRule;
 };
 
+inline uint64_t FreeCellGame::getPositionHash() const
+{
+  return positionHash;
+}
+
+inline void FreeCellGame::setAutoPlayRule(AutoPlayRule rule)
+{
+  autoPlayRule = rule;
+}
+
+inline size_t FreeCellGame::getColumnMemoryUsage() const
+{
+  return columns->memoryUsage();
+}
+
+inline size_t FreeCellGame::getColumnUsedMemory() const
+{
+  return columns->usedMemory();
+}
+
+inline void FreeCellGame::setDebug(Debug* debugger)
+{
+  this->debugger = (debugger != NULL) ? debugger : &Debug::getDefaultInstance();
+}
+
+inline int FreeCellGame::depthOfNextCardInSuit(CardSuit suit) const
+{
+  return depthsForNextCardInSuit[suit];
+}
+
+inline int FreeCellGame::getRunLength(int tableau) const
+{
+  return tableaus[tableau].empty() ? 0 : runLengths[tableau][tableaus[tableau].size() - 1];
+}
+
+inline int FreeCellGame::countEmptyTableaus() const
+{
+  return emptyTableaus;
+}
+
+inline unsigned int FreeCellGame::getPreferredMoveOriginMask() const
+{
+  return preferredOriginMask;
+}
+
 inline const FreeCells& FreeCellGame::getFreeCells()
 {
   return freeCells;
@@ -113,6 +269,17 @@ inline std::set<Card> FreeCellGame::getFreeCellSet()
   return freeCells.asSet();
 }
 
+inline unsigned int locationBit(Location loc)
+{
+  return 1u << loc;
+}
+
+// a number 0..51 that identifies a card
+inline int cardIndex(const Card& card)
+{
+  return card.suit * NUM_RANKS + card.num - 1;
+}
+
 inline int randInRange(int min, int max)
 {
   return min + int((max - min + 1.0) * rand() / (RAND_MAX + 1.0));
@@ -0,0 +1,174 @@
+// LogRing.cpp
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "LogRing.h"
+#include <chrono>
+#include <string.h>
+
+using namespace std;
+
+// how long the drain thread sleeps when there is nothing to write, and how
+// long flush sleeps between looks
+const chrono::microseconds kDrainIdleSleep(1000);
+const chrono::microseconds kFlushSleep(100);
+
+LogRing::LogRing()
+: writePosition(0), readPosition(0), dropped(0), stopping(false)
+{
+}
+
+LogRing::~LogRing()
+{
+  if (drainThread.joinable()) {
+    stopping = true;
+    drainThread.join();
+  }
+}
+
+// LogRing::push
+void LogRing::push(ostream* out, const char* text, size_t length)
+{
+  RecordHeader header;
+  uint64_t position = writePosition.load(memory_order_relaxed);
+
+  if (!bytes) {
+    bytes.reset(new char[kLogRingBytes]);
+    drainThread = thread(&LogRing::drain, this);
+  }
+  if (length > kLogRecordBytes) {
+    length = kLogRecordBytes;
+  }
+  if (position + sizeof(header) + length -
+      readPosition.load(memory_order_acquire) > kLogRingBytes) {
+    dropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  header.out = out;
+  header.length = length;
+  copyIn(position, &header, sizeof(header));
+  copyIn(position + sizeof(header), text, length);
+  writePosition.store(position + sizeof(header) + length, memory_order_release);
+}
+
+// LogRing::flush
+void LogRing::flush()
+{
+  uint64_t position = writePosition.load(memory_order_relaxed);
+
+  if (!drainThread.joinable()) {
+    return;
+  }
+  while (readPosition.load(memory_order_acquire) < position) {
+    this_thread::sleep_for(kFlushSleep);
+  }
+}
+
+// LogRing::drain
+// The drain thread. Writes out whatever has been pushed, flushes the stream
+// it last wrote to once it has caught up, and only then lets the space go,
+// so that flush knows the text has reached the stream.
+void LogRing::drain()
+{
+  char text[kLogRecordBytes];
+  RecordHeader header;
+  ostream* last = NULL;
+  uint64_t position = readPosition.load(memory_order_relaxed), end;
+  unsigned long lost;
+
+  for (;;) {
+    // read stopping first, so nothing pushed before it was set is missed
+    bool stop = stopping.load(memory_order_acquire);
+    end = writePosition.load(memory_order_acquire);
+    if (position == end) {
+      if (stop) {
+        break;
+      }
+      this_thread::sleep_for(kDrainIdleSleep);
+      continue;
+    }
+    while (position < end) {
+      copyOut(position, &header, sizeof(header));
+      copyOut(position + sizeof(header), text, header.length);
+      header.out->write(text, header.length);
+      last = header.out;
+      position += sizeof(header) + header.length;
+    }
+    lost = dropped.exchange(0, memory_order_relaxed);
+    if (lost > 0) {
+      *last << "[" << lost << " log records dropped]" << endl;
+    }
+    last->flush();
+    readPosition.store(position, memory_order_release);
+  }
+}
+
+void LogRing::copyIn(uint64_t position, const void* source, size_t length)
+{
+  size_t offset = size_t(position & (kLogRingBytes - 1));
+  size_t first = min(length, size_t(kLogRingBytes) - offset);
+
+  memcpy(&bytes[offset], source, first);
+  memcpy(&bytes[0], static_cast<const char*>(source) + first, length - first);
+}
+
+void LogRing::copyOut(uint64_t position, void* destination, size_t length) const
+{
+  size_t offset = size_t(position & (kLogRingBytes - 1));
+  size_t first = min(length, size_t(kLogRingBytes) - offset);
+
+  memcpy(destination, &bytes[offset], first);
+  memcpy(static_cast<char*>(destination) + first, &bytes[0], length - first);
+}
+
+
+LogLineBuffer::LogLineBuffer(LogRing* ring)
+: ring(ring), out(NULL)
+{
+  setp(line, line + kLogRecordBytes);
+}
+
+void LogLineBuffer::setStream(ostream* out)
+{
+  pushLine();
+  this->out = out;
+}
+
+// LogLineBuffer::overflow
+// A line longer than the buffer goes out in pieces.
+LogLineBuffer::int_type LogLineBuffer::overflow(int_type c)
+{
+  pushLine();
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int LogLineBuffer::sync()
+{
+  pushLine();
+  return 0;
+}
+
+void LogLineBuffer::pushLine()
+{
+  if (pptr() > pbase() && out != NULL) {
+    ring->push(out, pbase(), size_t(pptr() - pbase()));
+  }
+  setp(line, line + kLogRecordBytes);
+}
@@ -0,0 +1,107 @@
+// LogRing.h
+// Hands log lines to a thread of their own to write out.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef LOGRING_H
+#define LOGRING_H
+
+#include <ostream>
+#include <streambuf>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+  kLogRingBytes = 1 << 20, // a power of two
+  kLogRecordBytes = 256    // the most text one record carries
+};
+
+/**
+ * A ring buffer of log records, each a piece of text and the stream it is
+ * for, written out by a thread the ring starts the first time it is used.
+ * One thread at a time pushes and the ring's own thread pops, so neither
+ * ever takes a lock: the logging thread copies its text in and moves on,
+ * and only the drain thread waits on the streams. When the ring is full,
+ * records are dropped rather than stall the logging thread; the drain
+ * thread notes how many in the log.
+ * The ring's buffer is only allocated once something is pushed.
+ **/
+class LogRing {
+public:
+  LogRing();
+  // writes out whatever is still queued
+  ~LogRing();
+
+  // queues length bytes of text, at most kLogRecordBytes, for out
+  void push(std::ostream* out, const char* text, size_t length);
+  // waits until everything pushed so far is written out and its stream
+  // flushed; call it before closing or changing a stream that records
+  // were pushed for
+  void flush();
+
+private:
+  // what comes before the text of each record
+  struct RecordHeader {
+    std::ostream* out;
+    size_t length;
+  };
+
+  LogRing(const LogRing&);
+  LogRing& operator = (const LogRing&);
+
+  void drain();
+  void copyIn(uint64_t position, const void* source, size_t length);
+  void copyOut(uint64_t position, void* destination, size_t length) const;
+
+  std::unique_ptr<char[]> bytes;
+  // the bytes ever pushed and ever written out; each only goes up, and only
+  // one thread stores to each
+  std::atomic<uint64_t> writePosition;
+  std::atomic<uint64_t> readPosition;
+  std::atomic<unsigned long> dropped;
+  std::atomic<bool> stopping;
+  std::thread drainThread;
+};
+
+/**
+ * A stream buffer over a fixed array that hands what it holds to a LogRing
+ * whenever it is flushed, as endl does, or fills up. Formatting a line
+ * through it allocates nothing.
+ **/
+class LogLineBuffer : public std::streambuf {
+public:
+  explicit LogLineBuffer(LogRing* ring);
+
+  // the stream the lines are for
+  void setStream(std::ostream* out);
+
+protected:
+  virtual int_type overflow(int_type c);
+  virtual int sync();
+
+private:
+  void pushLine();
+
+  LogRing* ring;
+  std::ostream* out;
+  char line[kLogRecordBytes];
+};
+
+#endif
@@ -0,0 +1,110 @@
+// MoveBuffer.h
+// The moves getPossibleMoves finds, with their scores, in a fixed-size array.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef MOVEBUFFER_H
+#define MOVEBUFFER_H
+
+#include <assert.h>
+#include "CardMove.h"
+#include "CompactMove.h"
+
+enum {
+  // No position has more moves than this: 8 tableaus and 4 free cells to the
+  // foundations, 4 free cells to 8 tableaus, each tableau's top card and one
+  // run to each of the other 7, and 8 tableaus to a free cell.
+  kMaxPossibleMoves = 8 + 4 + 4 * 8 + 8 * 7 * 2 + 8
+};
+
+/**
+ * Lives on the stack of whoever asks for the moves, so finding them doesn't
+ * touch the heap. sort puts the best scoring move first; moves with the same
+ * score stay in the order they were added.
+ **/
+class MoveBuffer {
+public:
+  MoveBuffer() : count(0) {}
+
+  void add(const CardMove& move, long score);
+  void sort();
+  void clear();
+
+  unsigned int size() const;
+  bool empty() const;
+  CompactMove operator[](unsigned int i) const;
+  long scoreAt(unsigned int i) const;
+
+private:
+  struct ScoredMove {
+    long score;
+    CompactMove move;
+  };
+
+  ScoredMove moves[kMaxPossibleMoves];
+  unsigned int count;
+};
+
+inline void MoveBuffer::add(const CardMove& move, long score)
+{
+  assert(count < kMaxPossibleMoves);
+  moves[count].score = score;
+  moves[count].move = CompactMove(move);
+  count++;
+}
+
+// an insertion sort; there are rarely more than a few dozen moves, and they
+// come in roughly best first already
+inline void MoveBuffer::sort()
+{
+  unsigned int i, j;
+
+  for (i = 1; i < count; i++) {
+    ScoredMove moving = moves[i];
+    for (j = i; j > 0 && moves[j - 1].score < moving.score; j--) {
+      moves[j] = moves[j - 1];
+    }
+    moves[j] = moving;
+  }
+}
+
+inline void MoveBuffer::clear()
+{
+  count = 0;
+}
+
+inline unsigned int MoveBuffer::size() const
+{
+  return count;
+}
+
+inline bool MoveBuffer::empty() const
+{
+  return count == 0;
+}
+
+inline CompactMove MoveBuffer::operator[](unsigned int i) const
+{
+  return moves[i].move;
+}
+
+inline long MoveBuffer::scoreAt(unsigned int i) const
+{
+  return moves[i].score;
+}
+
+#endif // MOVEBUFFER_H
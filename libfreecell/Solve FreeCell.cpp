@@ -50,8 +50,18 @@
 
 #include "FreeCellGame.h"
 #include "Solve FreeCell.h"
-#include "MoveScorePair.h"
 #include <time.h>
+#include <limits.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+#include <sstream>
 
 using namespace std;
 extern void printSolution(const vector<CardMove>& soln);
@@ -71,571 +81,2537 @@ enum {
   ScorePenaltyForBuryingCard = 50,
 };
 
+const MoveScores kDefaultMoveScores = {
+  ScoreMoveToFoundation,
+  ScoreMoveOffFreeCell,
+  ScoreMoveToTableau,
+  ScoreMoveFromTableau,
+  ScoreMoveToFreeCell,
+  ScoreMoveToEmptyTableauPerRank,
+  ScoreMoveFromPreferredOrigin,
+  ScoreMoveToPreferredDestination,
+  ScorePenaltyForBuryingCard
+};
 
-///////////////////////////////////////////////////////////////////////////////
-// globals
-static bool gSolved;
+const SolverParameters kDefaultSolverParameters = {
+  kDefaultMoveScores,
+  kDefaultMaxMovesBetweenFoundationMoves,
+  kDefaultBestFirstWeight
+};
+
+// the names loadSolverParameters and writeSolverParameters use for the scores
+struct ScoreName {
+  const char* name;
+  long MoveScores::*score;
+};
+
+const ScoreName kScoreNames[] = {
+  {"toFoundation", &MoveScores::toFoundation},
+  {"offFreeCell", &MoveScores::offFreeCell},
+  {"toTableau", &MoveScores::toTableau},
+  {"fromTableau", &MoveScores::fromTableau},
+  {"toFreeCell", &MoveScores::toFreeCell},
+  {"toEmptyTableauPerRank", &MoveScores::toEmptyTableauPerRank},
+  {"fromPreferredOrigin", &MoveScores::fromPreferredOrigin},
+  {"toPreferredDestination", &MoveScores::toPreferredDestination},
+  {"penaltyForBuryingCard", &MoveScores::penaltyForBuryingCard}
+};
+
+// the searches add their expanded positions to the solve's count this many
+// at a time
+const unsigned int kNodeFlushInterval = 256;
+
+// how many positions isDeadEnd looks at before giving up on proving one lost
+const unsigned int kDeadEndProbePositions = 64;
+
+// what a solve counts, over all of its threads
+struct SolveCounts {
+  atomic<unsigned long long> nodesExpanded;
+  // positions isDeadEnd showed could not be won, and which were dropped
+  // without being searched
+  atomic<unsigned long long> positionsPruned;
+  // what the searches' position tables grew to, in bytes
+  atomic<size_t> tableMemory;
+  // the rest of the solve's stats, which each thread adds its own to once,
+  // when it is done
+  mutex statsLock;
+  SolverStats stats;
+  // when the solve started, and how long after that the progress callback
+  // is next due, in nanoseconds; see reportProgress
+  chrono::steady_clock::time_point startTime;
+  atomic<long long> nextProgress;
+  // set once the solve has gone over one of its limits; the searches check
+  // them every kNodeFlushInterval positions, in checkBudgets
+  atomic<bool> budgetExceeded;
+  // set once some search has run out of moves without passing over any
+  atomic<bool> searchCompleted;
+  chrono::steady_clock::time_point deadline;
+  size_t tableMemoryLimit; // for each search
+  // the line to the most cards on the foundations of any search so far
+  vector<CardMove> bestLine;
+};
+
+
+// A position reached by shortenWindow's breadth-first search, stored as the
+// move that reached it from its parent. Node 0 is the start of the window.
+struct PeepholeNode {
+  uint32_t parent;
+  CompactMove move;
+  unsigned short depth;
+};
 
-static FreeCellStates fcStates;
 
-static FreeCellGame game;
+///////////////////////////////////////////////////////////////////////////////
+// parallel search types
+
+// A piece of a parallel depth-first search: the moves to try from the
+// position reached by path. With no moves, all of them are tried.
+struct SearchTask {
+  vector<CompactMove> path;
+  vector<CompactMove> moves;
+  unsigned short movesSinceFoundation;
+};
+
+// Each worker adds tasks to and takes them from the back of its own queue,
+// and steals from the front of the others', where the biggest pieces are.
+struct WorkerQueue {
+  mutex lock;
+  deque<SearchTask> tasks;
+};
 
-static int append = false;
+struct ParallelSearch {
+  const vector<Tableau>* tableaus;
+  PortfolioSearch settings;
+  StateTable* states;
+  ColumnStore* columns;
+  unsigned int workerCount;
+  unique_ptr<WorkerQueue[]> queues;
+  // tasks made that have not yet been finished; the search is over when
+  // this gets to 0
+  atomic<int> outstandingTasks;
+  atomic<int> idleWorkers;
+  // set when a worker solves the game or one runs out of room
+  atomic<bool> finished;
+  // set when a worker passes over a move that might have led somewhere
+  atomic<bool> truncated;
+  // the first solution found, if any
+  mutex solutionLock;
+  vector<CardMove> solution;
+  // the flag of the portfolio the search is part of, if any
+  atomic<bool>* portfolioFinished;
+  // the solver, settings and counts of the solve the search is part of
+  Solver* solver;
+  const SolverSettings* solverSettings;
+  SolveCounts* solveCounts;
+};
 
-static string logPath;
 
-static bool stopRequested = false;
+///////////////////////////////////////////////////////////////////////////////
+// prototypes
+static Solver& defaultSolver();
+static void perturbScore(long* score, minstd_rand* random);
+static void expandRunMove(FreeCellGame* game, int from, int to, int count,
+                          vector<CardMove>* singles);
+static void performSingleMove(FreeCellGame* game, const CardMove& move,
+                              vector<CardMove>* singles);
+static double threadCpuTime();
+static double secondsSince(const chrono::steady_clock::time_point& start);
+static inline unsigned int stackingBit(const Card& card);
+static inline unsigned int wantedStackingBit(const Card& card);
+static bool setParameter(SolverParameters* parameters, const string& name, long value);
+static void getExactPosition(FreeCellGame& game, string* position);
+static void cutLoops(vector<CardMove>* moveList, const vector<Tableau>& tableaus,
+                     Debug* debugger);
+static void dropExcursions(vector<CardMove>* moveList);
+static void mergeMoves(vector<CardMove>* moveList);
+static bool shortenWindow(FreeCellGame* replay, vector<CardMove>* moveList, size_t start,
+                          size_t window, chrono::steady_clock::time_point deadline);
+static void getPathToPeepholeNode(const vector<PeepholeNode>& nodes, uint32_t node,
+                                  vector<CardMove>* path);
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Functions
 
-// solveFreeCell
-void solveFreeCell(vector<CardMove>* moveList, const vector<Tableau>& passedTableaus) {
+// Solver::solve
+SolveStatus Solver::solve(vector<CardMove>* moveList, const vector<Tableau>& tableaus,
+                          SolveStrategy strategy) {
+  vector<PortfolioSearch> searches(1);
+
+  searches[0].strategy = strategy;
+  searches[0].seed = (unsigned int)random();
+  searches[0].parameters = settings.parameters;
+  return solvePortfolio(moveList, tableaus, searches);
+}
+
+// Solver::solvePortfolio
+// Different seeds and settings can take wildly different times on the same
+// deal, so racing a few of them cuts off the long tail. With one search it
+// just runs in the calling thread.
+SolveStatus Solver::solvePortfolio(vector<CardMove>* moveList,
+                                   const vector<Tableau>& passedTableaus,
+                                   const vector<PortfolioSearch>& searches) {
   ofstream logfile;
-  Debug& debugger = Debug::getDefaultInstance();
   char * strStartTime, * strEndTime;
-
-  if (debugger.isEnabled()) {
-    if (append == LOG_MODE_APPEND) {
-      logfile.open(logPath.c_str(), ios_base::out | ios_base::app);
+  bool logging = debugger->isEnabled(), solved = false;
+  SolveStatus status;
+  SolveCounts counts;
+  // the searches run with a copy, taken as the solve starts, so every thread
+  // sees the same settings and none change under a search that is running
+  const SolverSettings searchSettings = settings;
+  Debug& debugger = *this->debugger;
+  chrono::steady_clock::time_point startTime = chrono::steady_clock::now(), phaseStart;
+  double startCpuTime = threadCpuTime();
+
+  if (logging) {
+    if (settings.append == LOG_MODE_APPEND) {
+      logfile.open(settings.logPath.c_str(), ios_base::out | ios_base::app);
     }
     else {
-      logfile.open(logPath.c_str());
+      logfile.open(settings.logPath.c_str());
     }
     debugger.setDebugStream(logfile);
 
     time_t startTime = time(NULL);
     strStartTime = ctime(&startTime);
     strStartTime[INDEX_TO_CHANGE_FROM_NEWLINE_TO_SPACE_FROM_CTIME] = ' ';
-    debugger << strStartTime << "Solve FreeCell library starting" << endl;
+    DEBUG_LOG(debugger, kDebugInfo, strStartTime << "Solve FreeCell library starting" << endl);
   }
 
-  gSolved = false;
-  // copy the passed tableaus to the game tableaus
-  game.setTableaus(passedTableaus);
   moveList->clear();
+  counts.nodesExpanded = 0;
+  counts.positionsPruned = 0;
+  counts.tableMemory = 0;
+  counts.stats = SolverStats();
+  counts.startTime = startTime;
+  counts.nextProgress = settings.progressInterval * 1000000LL;
+  counts.budgetExceeded = false;
+  counts.searchCompleted = false;
+  counts.deadline = startTime + chrono::milliseconds(settings.timeLimit);
+  counts.tableMemoryLimit = settings.tableMemoryLimit / max(searches.size(), size_t(1));
+  if (searches.size() == 1) {
+    SearchContext search(*this, searchSettings, &counts, NULL);
+    solved = search.runSearch(moveList, passedTableaus, searches[0]);
+  }
+  else if (searches.size() > 1) {
+    vector<vector<CardMove> > results(searches.size());
+    vector<thread> threads;
+    atomic<bool> finished(false);
+    atomic<int> winner(-1);
+    size_t i;
+
+    DEBUG_LOG(debugger, kDebugInfo, "Racing " << searches.size() << " searches" << endl);
+    // the Debug instance is not safe to share between threads
+    debugger.disable();
+    for (i = 0; i < searches.size(); i++) {
+      threads.push_back(thread(&SearchContext::runPortfolioSearch, &results[i], &passedTableaus,
+                               &searches[i], int(i), &finished, &winner, this,
+                               &searchSettings, &counts));
+    }
+    for (i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+    if (logging) {
+      debugger.enable();
+    }
+    if (winner >= 0) {
+      DEBUG_LOG(debugger, kDebugInfo, "Search " << winner << " finished first" << endl);
+      moveList->swap(results[winner]);
+      solved = true;
+    }
+  }
+  if (solved) {
+    status = kSolveSolved;
+  }
+  else if (stopRequested()) {
+    status = kSolveCancelled;
+  }
+  else if (counts.budgetExceeded) {
+    status = kSolveBudgetExceeded;
+  }
+  else if (counts.searchCompleted) {
+    status = kSolveUnsolvable;
+  }
+  else {
+    status = kSolveExhausted;
+  }
+  stats = counts.stats;
+  stats.nodesExpanded = counts.nodesExpanded;
+  stats.positionsPruned = counts.positionsPruned;
+  stats.tableMemory = counts.tableMemory;
+  DEBUG_LOG(debugger, kDebugInfo, "Expanded " << stats.nodesExpanded << " positions, pruned "
+                                  << stats.positionsPruned << " dead ends" << endl);
+
+  // the searches may have moved runs of cards in one go
+  phaseStart = chrono::steady_clock::now();
+  expandSupermoves(moveList, passedTableaus);
+  if (!solved) {
+    bestLine.swap(counts.bestLine);
+    expandSupermoves(&bestLine, passedTableaus);
+    DEBUG_LOG(debugger, kDebugInfo, "Stopped with at most " << stats.bestFoundationCards
+                                    << " cards on the foundations" << endl);
+  }
+  stats.optimizeTime += secondsSince(phaseStart);
 
-  solveFCRec(moveList);
   // validate the solution
-  debugger << "Validating initial solution..." << endl;
+  DEBUG_LOG(debugger, kDebugInfo, "Validating initial solution..." << endl);
+  phaseStart = chrono::steady_clock::now();
   if (!validateSolution(*moveList, passedTableaus)) {
     cerr << "Error: solution not valid." << endl;
   }
   else {
-    debugger << "Solution is valid" << endl;
+    DEBUG_LOG(debugger, kDebugInfo, "Solution is valid" << endl);
   }
+  stats.validateTime += secondsSince(phaseStart);
 
 #ifdef SOLVEFREECELL_LIB_THREADED
-  if (!stopRequested) {
+  if (!stopRequested()) {
 #endif
     // optimize solution
-    optimizeMoves(moveList);
-    debugger << "Validating optimized solution..." << endl;
+    phaseStart = chrono::steady_clock::now();
+    optimizeMoves(moveList, passedTableaus);
+    shortenSolution(moveList, passedTableaus);
+    stats.optimizeTime += secondsSince(phaseStart);
+    DEBUG_LOG(debugger, kDebugInfo, "Validating optimized solution..." << endl);
+    phaseStart = chrono::steady_clock::now();
     if (!validateSolution(*moveList, passedTableaus)) {
-      debugger << "Error: optimization caused the solution to be invalid." << endl;
+      DEBUG_LOG(debugger, kDebugError,
+                "Error: optimization caused the solution to be invalid." << endl);
     }
     else {
-      debugger << "Optimized solution is valid" << endl;
+      DEBUG_LOG(debugger, kDebugInfo, "Optimized solution is valid" << endl);
     }
+    stats.validateTime += secondsSince(phaseStart);
 #ifdef SOLVEFREECELL_LIB_THREADED
   }
 #endif
+  if (solved) {
+    bestLine = *moveList;
+  }
+  // the portfolio and parallel search threads have added their own
+  stats.cpuTime += threadCpuTime() - startCpuTime;
+  stats.wallTime = secondsSince(startTime);
+  if (logging) {
+    // the log's own lines get to the file on another thread
+    debugger.flush();
+    writeSolverStats(logfile, stats);
+  }
 
-  if (debugger.isEnabled()) {
+  if (logging) {
     time_t endTime = time(NULL);
     strEndTime = ctime(&endTime);
     strEndTime[INDEX_TO_CHANGE_FROM_NEWLINE_TO_SPACE_FROM_CTIME] = ' ';
-    debugger << strEndTime << "Solve FreeCell library finished\n" << endl;
+    DEBUG_LOG(debugger, kDebugInfo, strEndTime << "Solve FreeCell library finished\n" << endl);
+    debugger.flush();
     logfile.close();
   }
 
-  game.reset();
-  fcStates.clear();
-  stopRequested = false;
+  stopFlag = false;
+  return status;
 }
 
-// solveFCRec
-// Requirements: that the random seed has been suitably initialized.
-void solveFCRec(vector<CardMove>* moveList, unsigned short myCount) {
-#ifdef SOLVEFREECELL_LIB_THREADED
-  if (stopRequested) {
-    return;
+// SearchContext::runPortfolioSearch
+// The body of each portfolio thread. The first search to solve the game
+// claims the win and tells the rest to stop.
+void SearchContext::runPortfolioSearch(vector<CardMove>* moveList,
+                                       const vector<Tableau>* tableaus,
+                                       const PortfolioSearch* search, int index,
+                                       atomic<bool>* finished, atomic<int>* winner,
+                                       Solver* solver, const SolverSettings* settings,
+                                       SolveCounts* counts) {
+  SearchContext context(*solver, *settings, counts, finished);
+  int noWinner = -1;
+  double startCpuTime = threadCpuTime();
+
+  if (context.runSearch(moveList, *tableaus, *search) &&
+      winner->compare_exchange_strong(noWinner, index)) {
+    *finished = true;
   }
-#endif
-  priority_queue<MoveScorePair> possibleMoves;
-  bool foundationMovesOnly = (myCount == kMaxMovesBetweenFoundationMoves);
-  unsigned short newCount;
+  context.addSearchStats(threadCpuTime() - startCpuTime);
+}
 
-  possibleMoves = getPossibleMoves();
-  Debug::getDefaultInstance() << "Possible move count: " << possibleMoves.size() << endl;
+SearchContext::SearchContext()
+{
+  Solver& solver = defaultSolver();
 
-  while (!possibleMoves.empty()) {
-    const CardMove& curMove = possibleMoves.top().move();
-    possibleMoves.pop();
-    if (filterMove(*moveList, curMove)) {
-      continue; // skip this move
-    }
-    
-    if (!(foundationMovesOnly && curMove.dest != foundation)) {
-      if (curMove.dest == foundation)
-        newCount = 0;
-      else
-        newCount = myCount + 1;
+  init(solver, solver.getSettings(), NULL, NULL);
+}
 
-      makeMove(moveList, curMove);
-      if (!seenCurrentState() || curMove.dest == foundation) {
-        addState();
+SearchContext::SearchContext(Solver& solver)
+{
+  init(solver, solver.getSettings(), NULL, NULL);
+}
 
-        if (!game.gameIsSolved()) {
-          solveFCRec(moveList, newCount);
-          if (!gSolved) {
-            undoMove(moveList, curMove);
-          }
-          else return;	// game was solved in recursive call
-        }
-        else { // foundations are full -- just solved game
-          gSolved = true;
-          return;
-        }
-      }
-      else {	// we have seen the current state -- undo the move
-        undoMove(moveList, curMove);
-      }
-    }
-  }
+SearchContext::SearchContext(Solver& solver, const SolverSettings& settings,
+                             SolveCounts* counts, atomic<bool>* finished)
+{
+  init(solver, settings, counts, finished);
+}
+
+void SearchContext::init(Solver& solver, const SolverSettings& settings,
+                         SolveCounts* counts, atomic<bool>* finished)
+{
+  this->solver = &solver;
+  this->settings = &settings;
+  debugger = &solver.getDebug();
+  useParameters(settings.parameters);
+  randomSeed = 0;
+  resetSearchStats();
+  solveCounts = counts;
+  unflushedNodes = 0;
+  portfolioFinished = finished;
+  parallelSearch = NULL;
+  workerIndex = 0;
+  sharedStates = NULL;
+  game.setDebug(debugger);
 }
 
+// SearchContext::runSearch
+bool SearchContext::runSearch(vector<CardMove>* moveList, const vector<Tableau>& tableaus,
+                              const PortfolioSearch& search) {
+  bool solved, ownMoves = true;
 
-// getPossibleMoves
-// Get all the possible moves, in some heuristic order that should move the game
-// towards a solution.
-// 8/2/04 I have revised the move selection order to something that is more fine-grained.
-// It is based on a research paper written by two grad students in an AI course.
-// Their names are Kevin Atkinson and Shari Holstege. The paper is locatable online.
-// 8/15/04 Got rid of cumbersome vector storage for moves. Switched to priority queue.
-priority_queue<MoveScorePair> getPossibleMoves() {
-  unsigned int i, j;
-  set<Location> goodOrigins = game.getPreferredMoveOrigins();
-  set<Location> goodDestinations = game.getPreferredMoveDestinations();
-  const vector<Tableau>& tableaus = game.getTableaus();
-  const FreeCells& freeCells = game.getFreeCells();
-  unsigned short usedCells = freeCells.countUsedCells();
-  const Card* topTableauCards[kNumTableaus];
-  // yeah, use greater<>, just so I can keep my head straight: higher score => better
-  // longest type ever...
-  priority_queue<MoveScorePair> rankedMoves;
-  long score;
-  bool hasEmptyTableau = false;
-  Debug& debugger = Debug::getDefaultInstance();
+  useParameters(search.parameters);
+  randomSeed = search.seed;
+  fcStates.setUseHugePages(settings->useHugePages);
+  resetSearchStats();
 
-  // get top tableau cards
-  for (i = 0; i < kNumTableaus; i++) {
-    if (tableaus[i].empty()) {
-      topTableauCards[i] = NULL;
-      hasEmptyTableau = true;
-    }
-    else {
-      topTableauCards[i] = &tableaus[i].top();
-    }
+  // copy the passed tableaus to the game tableaus
+  game.setTableaus(tableaus);
+  moveList->clear();
+  startAutoMoves();
+  if (game.gameIsSolved()) {
+    solved = true;
   }
-
-  // 1. score moves for tableau => foundation
-  for (i = 0; i < kNumTableaus; i++) {
-    if (topTableauCards[i]) {
-      const Card& curCard = *topTableauCards[i];
-      if (curCard.num == game.nextFoundationRankForSuit(curCard.suit)) {
-        score = ScoreMoveToFoundation;
-        rankedMoves.push(MoveScorePair(CardMove(curCard, tableauToLoc(i), foundation), score));
-      }
-    }
+  else if (search.strategy == kStrategyBestFirst) {
+    solved = solveFCBestFirst(moveList);
   }
-
-  // 1. Add moves for free cells => foundation
-  for (i = 0; i < usedCells; i++) {
-    Card const& curCard = freeCells.get(i);
-    if (curCard.num == game.nextFoundationRankForSuit(curCard.suit)) {
-      score = ScoreMoveToFoundation;
-      rankedMoves.push(MoveScorePair(CardMove(curCard, cell, foundation), score));
-    }
+  else if (search.strategy == kStrategyParallelDepthFirst) {
+    solved = solveFCParallel(moveList, tableaus, search);
+    // the workers have put their own auto moves in already
+    ownMoves = false;
   }
-
-  // add moves for free cells => tableau
-  for (i = 0; i < usedCells; i++) {
-    Card const& curCard = freeCells.get(i);
-    for (j = 0; j < kNumTableaus; j++) {
-      score = ScoreMoveToTableau + ScoreMoveOffFreeCell;
-      Location loc = tableauToLoc(j);
-      if (goodDestinations.find(loc) != goodDestinations.end()) {
-        score += ScoreMoveToPreferredDestination;
-      }
-      // 8/21/04 added penalty based on how deep the next useful cards are in the tableaus
-      else {
-        int depth = game.depthOfNextFoundationCardForTableau(j);
-        if (depth > 0) {
-          score -= ScorePenaltyForBuryingCard; 
-        }
-      }
-      if (topTableauCards[j] == NULL) {
-        score += ScoreMoveToEmptyTableauPerRank * curCard.num;
-        rankedMoves.push(MoveScorePair(CardMove(curCard, cell, loc), score));
-      }
-      else if (canPlaceOnTop(curCard, *topTableauCards[j])) {
-        rankedMoves.push(MoveScorePair(CardMove(curCard, cell, loc), score));
-      }
+  else {
+    solved = solveFCIterative(moveList);
+  }
+  if (solved && ownMoves) {
+    includeAutoMoves(moveList);
+  }
+  else if (!solved) {
+    // a search that was stopped leaves the path it was on
+    moveList->clear();
+    if (!searchStats.truncated && !searchCancelled() && solveCounts != NULL) {
+      solveCounts->searchCompleted = true;
     }
   }
+  flushExpandedNodes();
+  countTableMemory(fcStates.memoryUsage() + game.getColumnMemoryUsage());
+  addSearchStats(0);
+  game.reset();
+  fcStates.clear();
+  return solved;
+}
 
-  // add moves for tableau => different tableau
-  for (i = 0; i < kNumTableaus; i++) {
-    if (topTableauCards[i]) {
-      for (j = 0; j < kNumTableaus; j++) {
-        if (i != j) {
-          score = ScoreMoveFromTableau + ScoreMoveToTableau;
-          Location originLoc = tableauToLoc(i);
-          Location destLoc = tableauToLoc(j);
-          if (goodOrigins.find(originLoc) != goodOrigins.end()) {
-            score += ScoreMoveFromPreferredOrigin;
-          }
-          if (goodDestinations.find(destLoc) != goodDestinations.end()) {
-            score += ScoreMoveToPreferredDestination;
-          }
-          else {
-            int depth = game.depthOfNextFoundationCardForTableau(j);
-            if (depth > 0) {
-              score -= ScorePenaltyForBuryingCard;
-            }
-          }
-          if (topTableauCards[j] == NULL) {
-            score += ScoreMoveToEmptyTableauPerRank * topTableauCards[i]->num;
-            rankedMoves.push(MoveScorePair(CardMove(*topTableauCards[i], originLoc, destLoc), score));
-          }
-          else if (canPlaceOnTop(*topTableauCards[i], *topTableauCards[j])) {
-            rankedMoves.push(MoveScorePair(CardMove(*topTableauCards[i], originLoc, destLoc), score));
-          }
-        }
-      }
+// SearchContext::setSearchPosition
+bool SearchContext::setSearchPosition(const vector<Tableau>& tableaus,
+                                      const vector<CardMove>& moves) {
+  size_t i;
+
+  useParameters(settings->parameters);
+  game.reset();
+  game.setTableaus(tableaus);
+  fcStates.clear();
+  for (i = 0; i < moves.size(); i++) {
+    if (!game.performMove(moves[i])) {
+      return false;
     }
   }
-  
-  // add moves for tableau => free cell
-  // 7/31/01 added randomization
-  if (usedCells < 4) {
-    unsigned char indices[kNumTableaus];
-    getRandomIndices(indices, kNumTableaus);
-    for (i = 0; i < kNumTableaus; i++) {
-      if (topTableauCards[indices[i]]) {
-        score = ScoreMoveFromTableau + ScoreMoveToFreeCell;
-        Location originLoc = tableauToLoc(indices[i]);
-        if (goodOrigins.find(originLoc) != goodOrigins.end()) {
-          score += ScoreMoveFromPreferredOrigin;
-        }
-        rankedMoves.push(MoveScorePair(CardMove(*topTableauCards[indices[i]], originLoc, cell), score));
-      }
+  startAutoMoves();
+  return true;
+}
+
+// Solver::getDefaultPortfolio
+// Alternates the two strategies. Past the first pair, each search also gets a
+// different best-first weight, and every move score is nudged by up to a
+// quarter either way.
+void Solver::getDefaultPortfolio(vector<PortfolioSearch>* searches, unsigned int count) {
+  unsigned int i;
+
+  searches->resize(count);
+  for (i = 0; i < count; i++) {
+    PortfolioSearch& search = (*searches)[i];
+    search.strategy = (i % 2 == 0) ? kStrategyBestFirst : kStrategyDepthFirst;
+    search.seed = (unsigned int)random();
+    search.parameters = settings.parameters;
+    search.parameters.bestFirstWeight += (i / 2) % 4 * 2;
+    if (i >= 2) {
+      MoveScores& scores = search.parameters.scores;
+      perturbScore(&scores.offFreeCell, &random);
+      perturbScore(&scores.toTableau, &random);
+      perturbScore(&scores.fromTableau, &random);
+      perturbScore(&scores.toFreeCell, &random);
+      perturbScore(&scores.toEmptyTableauPerRank, &random);
+      perturbScore(&scores.fromPreferredOrigin, &random);
+      perturbScore(&scores.toPreferredDestination, &random);
+      perturbScore(&scores.penaltyForBuryingCard, &random);
     }
   }
-
-  return rankedMoves;
 }
 
+static void perturbScore(long* score, minstd_rand* random) {
+  *score = *score * uniform_int_distribution<long>(75, 125)(*random) / 100;
+}
 
-void makeMove(vector<CardMove>* moveList, const CardMove& theMove) {
-  game.performMove(theMove);
-  moveList->push_back(theMove);
+// SearchContext::startAutoMoves
+// Call once the game is set up, before the search makes any moves: sets the
+// game's auto play rule and plays what it allows from the starting position.
+void SearchContext::startAutoMoves() {
+  game.setAutoPlayRule(settings->autoPlayRule);
+  autoMoves.clear();
+  autoMoveCounts.clear();
+  autoMoveCounts.push_back((unsigned char)game.playAutoMoves(&autoMoves));
+  countFoundationCards(vector<CardMove>());
 }
 
+// SearchContext::includeAutoMoves
+// Puts the auto moves into the solution, each chain after the move that led
+// to it.
+void SearchContext::includeAutoMoves(vector<CardMove>* moveList) {
+  vector<CardMove> solution;
 
-void undoMove(vector<CardMove>* moveList, const CardMove& theMove) {
-  game.undoMove(theMove);
-  moveList->pop_back();
+  getLineWithAutoMoves(*moveList, &solution);
+  moveList->swap(solution);
 }
 
-/**
-* filterMove: return a boolean, true if prospectiveMove should be filtered (skipped),
- * false if it should be performed.
- * The point of filterMove is to ignore possible moves that are provably asinine.
- * The filter is allowed to look at past moves and the state of the tableaus.
- **/
-bool filterMove(const vector<CardMove>& moves, const CardMove& prospectiveMove)
-{
-  if (prospectiveMove.dest == foundation) { // avoid doing stupid things...
-    return false;
+// SearchContext::getLineWithAutoMoves
+// The same, into line, for the search's current move list.
+void SearchContext::getLineWithAutoMoves(const vector<CardMove>& moveList,
+                                         vector<CardMove>* line) {
+  size_t i, next = 0;
+  int j;
+
+  line->clear();
+  line->reserve(moveList.size() + autoMoves.size());
+  for (i = 0; i <= moveList.size(); i++) {
+    if (i > 0) {
+      line->push_back(moveList[i - 1]);
+    }
+    for (j = 0; j < autoMoveCounts[i]; j++) {
+      line->push_back(autoMoves[next++]);
+    }
   }
+}
 
-  const vector<Tableau>& tableaus = game.getTableaus();
+// true once the search should give up
+inline bool SearchContext::searchCancelled() {
+  return solver->stopRequested() ||
+         (portfolioFinished != NULL && portfolioFinished->load(memory_order_relaxed)) ||
+         (parallelSearch != NULL && parallelSearch->finished.load(memory_order_relaxed)) ||
+         (solveCounts != NULL && solveCounts->budgetExceeded.load(memory_order_relaxed));
+}
 
-  // filter moves that take a card off a very "stable" tableau: a tableau based on a king, is stacked
-  // correctly and is 3 or more cards
-  if (isLocTableau(prospectiveMove.from)) {
-    const Tableau& tableau = tableaus[locToTableau(prospectiveMove.from)];
-    if (tableau.peek(0).num == 13 && tableau.size() >= 3) { // if the bottom card is a king...
-      // move from the top of the tableau to the bottom
-      for (int i = tableau.size() - 1; i > 0; i--) {
-        // compare this card to the one below it
-        if (!canPlaceOnTop(tableau.peek(i), tableau.peek(i - 1))) {
-          return false; // it's not a perfect stack, move may not be asinine
-        }
-      }
-      Debug::getDefaultInstance() << "filtering a move: stable tableau rule" << endl;
-      return true;
+// counts a position whose moves the search is about to look at
+inline void SearchContext::countExpandedNode() {
+  if (++unflushedNodes == kNodeFlushInterval) {
+    flushExpandedNodes();
+    checkBudgets();
+    if (settings->progressCallback != NULL) {
+      reportProgress();
     }
   }
+}
 
-  // filter 2: don't move a card to Location x that is identically stackable to a card that was just moved off of
-  // location x, if x is a tableau. That is asinine.
-  if (isLocTableau(prospectiveMove.dest) && moves.size() > 0) {
-    if (prospectiveMove.dest == moves.back().from && prospectiveMove.card.num == moves.back().card.num &&
-        prospectiveMove.card.hasSuitOfSameColorAs(moves.back().card)) {
-      Debug::getDefaultInstance() << "filtering a move: move equivalent card rule" << endl;
-      return true;
-    }
+// adds the search's uncounted positions to the solve's count
+void SearchContext::flushExpandedNodes() {
+  if (solveCounts != NULL) {
+    solveCounts->nodesExpanded.fetch_add(unflushedNodes, memory_order_relaxed);
   }
+  unflushedNodes = 0;
+}
 
-  // filter 3: don't move the same card twice in a row.
-  if (moves.size() > 0 && prospectiveMove.card == moves.back().card) {
-    return true;
+void SearchContext::countPrunedPosition() {
+  if (solveCounts != NULL) {
+    solveCounts->positionsPruned.fetch_add(1, memory_order_relaxed);
   }
-
-  return false;
 }
 
-bool canPlaceOnTop(const Card& c, const Card& target) {
-  return c.num == target.num - 1 &&
-  (((c.suit == clubs || c.suit == spades) &&
-    (target.suit == hearts || target.suit == diamonds)) ||
-   ((c.suit == hearts || c.suit == diamonds) &&
-    (target.suit == clubs || target.suit == spades)));
+void SearchContext::countTableMemory(size_t bytes) {
+  if (solveCounts != NULL) {
+    solveCounts->tableMemory.fetch_add(bytes, memory_order_relaxed);
+  }
 }
 
-// getRandomIndices
-template <typename index_type>
-void getRandomIndices(index_type indices[], int n) {
-  int i, j;
-  int* rands = new int[n];
-  for (i = 0; i < n; i++) {
-    indices[i] = i;
-    rands[i] = rand();
+// SearchContext::reportProgress
+// Calls the progress callback if it is due. The searches only look every
+// kNodeFlushInterval positions, so the clock is read that often at most. The
+// thread that claims a report pushes the next one out of reach while the
+// callback runs, so no other thread starts one meanwhile.
+void SearchContext::reportProgress() {
+  SolverProgress progress;
+  long long now, due;
+
+  if (solveCounts == NULL) {
+    return;
+  }
+  now = chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now() - solveCounts->startTime).count();
+  due = solveCounts->nextProgress.load(memory_order_relaxed);
+  if (now < due || !solveCounts->nextProgress.compare_exchange_strong(due, LLONG_MAX)) {
+    return;
   }
-  // bubble sort
-  for (i = 1; i < n; i++)
-    for (j = 0; j < n - i; j++)
-      if (rands[indices[j]] > rands[indices[j + 1]]) {
-        index_type temp = indices[j];
-        indices[j] = indices[j + 1];
-        indices[j + 1] = temp;
-      }
 
-        delete[] rands;
+  progress.nodesExpanded = solveCounts->nodesExpanded.load(memory_order_relaxed);
+  progress.elapsedTime = now * 1e-9;
+  progress.nodesPerSecond = progress.elapsedTime > 0
+                            ? progress.nodesExpanded / progress.elapsedTime : 0;
+  progress.depth = (unsigned int)autoMoveCounts.size() - 1;
+  progress.bestFoundationCards = searchStats.bestFoundationCards;
+  progress.tableSize = sharedStates != NULL ? sharedStates->size() : fcStates.size();
+  settings->progressCallback(progress, settings->progressContext);
+
+  now = chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now() - solveCounts->startTime).count();
+  solveCounts->nextProgress.store(now + settings->progressInterval * 1000000LL);
 }
 
-void addState()
-{
-  FreeCellStates::iterator lookup;
-  set<Tableau> tableauSet = game.getTableauSet();
-  lookup = fcStates.find(tableauSet);
-  if (lookup == fcStates.end())
-  {
-    pair<set<Tableau>, set<set<Card> > > newPair;
-    newPair.first = tableauSet;
-    newPair.second.insert(game.getFreeCellSet());
-    fcStates.insert(newPair);
+// SearchContext::checkBudgets
+// Flags the solve as over budget once it has expanded as many positions as
+// it may, run out of time, or this search's table has outgrown its share.
+// The clock is only read with a time limit set. The shared tables of a
+// parallel search are charged for what is in them, not for the memory set
+// aside for them up front.
+void SearchContext::checkBudgets() {
+  size_t tableMemory;
+
+  if (solveCounts == NULL) {
+    return;
+  }
+  if (settings->nodeLimit != 0 &&
+      solveCounts->nodesExpanded.load(memory_order_relaxed) >= settings->nodeLimit) {
+    solveCounts->budgetExceeded = true;
   }
-  else
-  {
-    (*lookup).second.insert(game.getFreeCellSet());
+  if (settings->timeLimit != 0 && chrono::steady_clock::now() >= solveCounts->deadline) {
+    solveCounts->budgetExceeded = true;
+  }
+  if (settings->tableMemoryLimit != 0) {
+    tableMemory = (sharedStates != NULL ? sharedStates->usedMemory() : fcStates.usedMemory()) +
+                  game.getColumnUsedMemory();
+    if (tableMemory > solveCounts->tableMemoryLimit) {
+      solveCounts->budgetExceeded = true;
+    }
   }
 }
 
-bool seenCurrentState()
-{
-  FreeCellStates::iterator lookup;
-  set<Tableau> tableauSet = game.getTableauSet();
-  lookup = fcStates.find(tableauSet);
-  if (lookup == fcStates.end())
-    return false;
-  else
-  {
-    set<set<Card> >& seenFreeCells = (*lookup).second;
-    if (seenFreeCells.find(game.getFreeCellSet()) == seenFreeCells.end())
-      return false;
-    else
-      return true;
+// SearchContext::countFoundationCards
+// Keeps the most cards the search has had on the foundations, and the line
+// that got there, up to date. The count only goes up, so the line is copied
+// at most once per card.
+void SearchContext::countFoundationCards(const vector<CardMove>& moveList) {
+  unsigned int cards = 0;
+  int suit;
+
+  for (suit = 0; suit < NUM_SUITS; suit++) {
+    cards += game.nextFoundationRankForSuit(CardSuit(suit)) - 1;
+  }
+  if (cards > searchStats.bestFoundationCards) {
+    searchStats.bestFoundationCards = cards;
+    getLineWithAutoMoves(moveList, &searchStats.bestLine);
   }
 }
 
-// TODO: Integrate optimizations into the core algorithm because optimizations are
-// tedious and dangerous (see comment in opt. 1 below).
-// Optimize a sequence of moves by removing silly sequences that the solver created.
-// Currently, this function works without knowing what's on the tableaus, so it only
-// does some simple optimizations that can be applied based on knowledge of just the
-// moves.
-// Currently, the optimizations are:
-// 1) The algorithm may generate the following:
-//    - Move a card (T, suit) that is properly stacked on a tableau to a free cell.
-//    - Move the other card (T, suit') where suit is the other suit of the same color,
-//      which also happens to be on top of another tableau, to the tableau (T, suit) was
-//      on.
-//    - Move (T, suit) to where (T, suit') was.
-//    This can happen if there are no moves of Type 1-4 as described in getPossibleMoves.
-//    The solver happens to choose (T, suit), after which is moved to a free cell, allows
-//    a type 4 move and then a type 3 move. This is not caught by the state checker
-//    because it is technically a different state.
-// 2) If a card is moved from a) a tableau to a free cell or b) a tableau to a tableau,
-//    and then is moved back to the tableau before the tableau is otherwise modified,
-//    that is pointless.
-// 3) If a card is moved twice in a row, combine the moves.
-//
-// Since one of these optimizations can produce an opportunity for another optimization to be
-// run again, we loopp through these optimizations until there are no changes.
-void optimizeMoves(vector<CardMove>* moveList)
-{
-  unsigned int move, startingMoveCount;
-  bool optimized; 
-
-  Debug::getDefaultInstance() << "Optimizing" << endl;
+void SearchContext::resetSearchStats() {
+  searchStats = SearchStats();
+}
 
-  do {
-#ifdef SOLVEFREECELL_LIB_THREADED
-    // heed the request to stop, even when optimizing
-    if (stopRequested) {
-      break;
+// SearchContext::addSearchStats
+// Adds what the search counted, and the CPU time it took, to the solve's
+// stats, and starts the counts over. The sampled phase times are
+// only as good as their samples, so a search that made fewer than
+// kStatsSampleInterval calls to a phase reports none for it.
+void SearchContext::addSearchStats(double cpuTime) {
+  const double kSecondsPerNanosecond = 1e-9;
+  unsigned int i;
+
+  if (solveCounts != NULL) {
+    lock_guard<mutex> guard(solveCounts->statsLock);
+    SolverStats& stats = solveCounts->stats;
+    stats.movesGenerated += searchStats.movesGenerated;
+    for (i = 0; i < kFilterRuleCount; i++) {
+      stats.movesFiltered[i] += searchStats.movesFiltered[i];
     }
+    stats.statesAdded += searchStats.statesAdded;
+    stats.statesSeen += searchStats.statesSeen;
+    stats.backtracks += searchStats.backtracks;
+    stats.maxDepth = max(stats.maxDepth, searchStats.maxDepth);
+    if (searchStats.bestFoundationCards > stats.bestFoundationCards ||
+        solveCounts->bestLine.empty()) {
+      stats.bestFoundationCards = searchStats.bestFoundationCards;
+      solveCounts->bestLine.swap(searchStats.bestLine);
+    }
+    stats.moveGenerationTime +=
+        searchStats.phaseNanoseconds[kPhaseMoveGeneration] * kSecondsPerNanosecond;
+    stats.dedupTime += searchStats.phaseNanoseconds[kPhaseDedup] * kSecondsPerNanosecond;
+    stats.makeUndoTime += searchStats.phaseNanoseconds[kPhaseMakeUndo] * kSecondsPerNanosecond;
+    stats.cpuTime += cpuTime;
+  }
+  resetSearchStats();
+}
+
+// threadCpuTime
+// The CPU time the calling thread has used, in seconds. Where there is no
+// clock for a thread, it falls back on the process's.
+static double threadCpuTime() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec now;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0) {
+    return now.tv_sec + now.tv_nsec * 1e-9;
+  }
 #endif
+  return double(clock()) / CLOCKS_PER_SEC;
+}
 
-    startingMoveCount = moveList->size();
+static double secondsSince(const chrono::steady_clock::time_point& start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
 
-    // perform optimization 1
-    // optimization 1 is BROKEN because it doesn't account for the fact that
-    // the 2 cards of same color and rank are different with respect to
-    // foundations, so we can't swap the cards for the rest of the game and we can't
-    // guarantee that we can just put the original card on the foundation
-#if 0
-    move = 0;
-    while (move < int(moveList->size()) - 2) {
-      const CardMove& thisMove = moveList->at(move);
-      const CardMove& nextMove = moveList->at(move + 1);
-      const CardMove& moveAfterNext = moveList->at(move + 2);
-      optimized = false;
-
-      if (isLocTableau(thisMove.from) && thisMove.dest == cell) {
-        if (nextMove.dest == thisMove.from &&
-            thisMove.card.hasSuitOfSameColorAs(nextMove.card) &&
-            thisMove.card.num == nextMove.card.num) {
-          if (moveAfterNext.card == thisMove.card && moveAfterNext.dest == nextMove.from) {
-            // all conditions are met for optimization 1
-            Debug::getDefaultInstance() << "Performing optimization type 1 on move " << move + 1 << endl;
-            // erase the moves
-            optimized = true;
-            Card card1 = thisMove.card;
-            Card card2 = nextMove.card;
-            int index;
-            moveList->erase(moveList->begin() + move, moveList->begin() + move + 3);
-            // let's not forget, the state has changed: the cards are swapped from what
-            // the solver output for the rest of the game
-            for (index = move; index < moveList->size(); index++) {
-              // FIX 7/31/04
-              if (moveList->at(index).card == card1) {
-                moveList->at(index).card = card2;
-              }
-              else if (moveList->at(index).card == card2) {
-                moveList->at(index).card = card1;
-              }
-            }
-          }
-        }
-      }
+// PhaseSample
+// Times one call to a phase of the search in every kStatsSampleInterval,
+// from its construction to the end of its scope, and counts it for all of
+// them. Reading the clock on every call would cost more than some of the
+// phases do.
+class PhaseSample {
+public:
+  PhaseSample(SearchStats& searchStats, SearchPhase phase)
+    : searchStats(searchStats), phase(phase),
+      timed((++searchStats.phaseCalls[phase] & (kStatsSampleInterval - 1)) == 0) {
+    if (timed) {
+      start = chrono::steady_clock::now();
+    }
+  }
 
-      if (!optimized) {
-        move++;
-      }
+  ~PhaseSample() {
+    if (timed) {
+      searchStats.phaseNanoseconds[phase] += kStatsSampleInterval *
+          chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
     }
-    // done optimization 1
-#endif
+  }
 
-    for (move = 0; move < moveList->size(); move++) {
-      const CardMove& thisMove = moveList->at(move);
-      if (isLocTableau(thisMove.from) && thisMove.dest != foundation) {
-        Card watchCard = thisMove.card;
-        // search till when it's moved next, noting if its origin tableau is modified.
-        // Also need to be careful if the destination is tableau and it is modified (i.e. another
-        // card placed on top -- then we can't optimize
-        Location origin = thisMove.from;
-        Location otherWatchLocation = thisMove.dest;
-        unsigned int index;
-        bool done = false;
-        bool checkOtherLocation = isLocTableau(otherWatchLocation);
-        for (index = move + 1; index < moveList->size() && !done; index++) {
-          const CardMove& futureMove = moveList->at(index);
-          if (futureMove.card == watchCard) {
-            if (futureMove.dest == origin) {
-              Debug::getDefaultInstance() << "Performing optimization 2 on move " << move + 1 << endl;
-              // the card moves back to its origin before its origin has changed.
-              // optimize away the 2 moves
-              // NOTE: using the fact that index > move, to erase index first
-              moveList->erase(moveList->begin() + index, moveList->begin() + index + 1);
-              moveList->erase(moveList->begin() + move, moveList->begin() + move + 1);
-            }
-            done = true;
-          }
-          else if (futureMove.from == origin || futureMove.dest == origin) {
-            // the tableau changes state, so the move may be necessary
-            done = true;
-          }
-          else if (checkOtherLocation && futureMove.dest == otherWatchLocation) {
-            done = true;
+private:
+  SearchStats& searchStats;
+  SearchPhase phase;
+  bool timed;
+  chrono::steady_clock::time_point start;
+};
+
+// SearchContext::solveFCIterative
+// Depth-first search over the moves from getPossibleMoves, best first. The
+// search keeps its own stack instead of recursing: each frame holds the moves
+// still to try from one position, as a range of the shared move stack, so a
+// deep search costs a few bytes per level and no call stack.
+// Returns true if the game was solved, with the solution in moveList.
+// Requirements: that the random seed has been suitably initialized.
+bool SearchContext::solveFCIterative(vector<CardMove>* moveList) {
+  vector<SearchFrame> frames;
+  vector<CompactMove> moveStack;
+
+  frames.reserve(kInitialSearchDepth);
+  moveStack.reserve(kInitialSearchDepth * 16);
+  pushSearchFrame(&frames, &moveStack, 0);
+  return searchFrames(moveList, &frames, &moveStack);
+}
+
+// SearchContext::searchFrames
+// The depth-first search loop. frames[0] holds the moves to try from the
+// current position; the search carries on until one of them leads to a
+// solution or all of them have been tried. During a parallel search, it
+// hands some of its untried moves to the other threads when they run out.
+bool SearchContext::searchFrames(vector<CardMove>* moveList, vector<SearchFrame>* frames,
+                                 vector<CompactMove>* moveStack) {
+  size_t baseDepth = moveList->size();
+  bool foundationMovesOnly;
+  unsigned short newCount;
+
+  while (!frames->empty()) {
+    if (searchCancelled()) {
+      return false;
+    }
+    if (parallelSearch != NULL && parallelSearch->idleWorkers.load(memory_order_relaxed) > 0) {
+      shareWork(*moveList, baseDepth, frames, *moveStack);
+    }
+    SearchFrame& frame = frames->back();
+    if (frame.nextMove == frame.endMove && !addNextMoveStage(&frame, moveStack)) {
+      // every move from this position failed; back up to the one before it
+      moveStack->erase(moveStack->begin() + frame.firstMove, moveStack->end());
+      frames->pop_back();
+      if (!frames->empty()) {
+        undoMove(moveList, moveList->back());
+      }
+      continue;
+    }
+
+    CardMove curMove = (*moveStack)[frame.nextMove++].toCardMove();
+    if (filterMove(*moveList, curMove)) {
+      continue; // skip this move
+    }
+    // What the limit lets through depends on the order positions are first
+    // seen in, and threads sharing a state table see them in no fixed order;
+    // with the limit, a parallel search can miss every solution. Without it,
+    // each position is searched once by some thread, which always finds one.
+    foundationMovesOnly = (parallelSearch == NULL &&
+                           frame.movesSinceFoundation >= maxMovesBetweenFoundationMoves);
+    if (foundationMovesOnly && curMove.dest != foundation) {
+      searchStats.truncated = true;
+      continue;
+    }
+    if (curMove.dest == foundation)
+      newCount = 0;
+    else
+      newCount = frame.movesSinceFoundation + 1;
+
+    makeMove(moveList, curMove);
+    if (autoMoveCounts.back() > 0) {
+      newCount = 0;
+    }
+    if (addStateIfUnseen() || curMove.dest == foundation) {
+      if (game.gameIsSolved()) {
+        return true;
+      }
+      if (isDeadEnd()) {
+        countPrunedPosition();
+        undoMove(moveList, curMove);
+        continue;
+      }
+      pushSearchFrame(frames, moveStack, newCount);
+    }
+    else {	// we have seen the current state -- undo the move
+      undoMove(moveList, curMove);
+    }
+  }
+  return false;
+}
+
+// SearchContext::solveFCParallel
+// The depth-first search on several threads. Each worker runs the same loop
+// as solveFCIterative on a task, a path into the game and the moves to try
+// from there. Whenever some worker is idle, the busy ones give away the
+// untried moves of their shallowest frame. The workers share one state table
+// and one column store, both fixed in size, so a position seen by one is
+// seen by all.
+bool SearchContext::solveFCParallel(vector<CardMove>* moveList, const vector<Tableau>& tableaus,
+                                    const PortfolioSearch& portfolioSearch) {
+  ParallelSearch search;
+  StateTable states(settings->parallelCapacity);
+  // there are far fewer distinct tableaus than positions; the store never
+  // gets smaller than its own minimum, however small the capacity
+  ColumnStore columns(settings->parallelCapacity / 4);
+  SearchTask rootTask;
+  vector<thread> threads;
+  Debug& debugger = *this->debugger;
+  bool logging = debugger.isEnabled();
+  unsigned int i;
+
+  search.tableaus = &tableaus;
+  search.settings = portfolioSearch;
+  search.states = &states;
+  search.columns = &columns;
+  search.workerCount = settings->searchThreads != 0 ? settings->searchThreads
+                                                    : thread::hardware_concurrency();
+  if (search.workerCount == 0) {
+    search.workerCount = 1;
+  }
+  search.queues.reset(new WorkerQueue[search.workerCount]);
+  search.outstandingTasks = 1;
+  search.idleWorkers = 0;
+  search.finished = false;
+  search.truncated = false;
+  search.portfolioFinished = portfolioFinished;
+  search.solver = solver;
+  search.solverSettings = settings;
+  search.solveCounts = solveCounts;
+
+  rootTask.movesSinceFoundation = 0;
+  search.queues[0].tasks.push_back(rootTask);
+
+  DEBUG_LOG(debugger, kDebugInfo, "Searching on " << search.workerCount << " threads" << endl);
+  // the Debug instance is not safe to share between threads
+  if (logging) {
+    debugger.disable();
+  }
+  for (i = 0; i < search.workerCount; i++) {
+    threads.push_back(thread(&SearchContext::runParallelWorker, &search, int(i)));
+  }
+  for (i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+  if (logging) {
+    debugger.enable();
+  }
+  DEBUG_LOG(debugger, kDebugInfo, "Remembered " << states.size() << " positions" << endl);
+  countTableMemory(states.memoryUsage() + columns.memoryUsage());
+  searchStats.truncated = search.truncated;
+
+  moveList->swap(search.solution);
+  return !moveList->empty();
+}
+
+// SearchContext::runParallelWorker
+// The body of each thread of a parallel search, which searches in a context
+// of its own.
+void SearchContext::runParallelWorker(ParallelSearch* search, int index) {
+  SearchContext worker(*search->solver, *search->solverSettings, search->solveCounts,
+                       search->portfolioFinished);
+
+  worker.runWorker(search, index);
+}
+
+void SearchContext::runWorker(ParallelSearch* search, int index) {
+  vector<CardMove> moveList;
+  vector<SearchFrame> frames;
+  vector<CompactMove> moveStack;
+  SearchTask task;
+  SearchFrame frame;
+  size_t i;
+  double startCpuTime = threadCpuTime();
+
+  useParameters(search->settings.parameters);
+  randomSeed = search->settings.seed + index;
+  parallelSearch = search;
+  workerIndex = index;
+  sharedStates = search->states;
+  frames.reserve(kInitialSearchDepth);
+  moveStack.reserve(kInitialSearchDepth * 16);
+
+  try {
+    game.setColumnStore(search->columns);
+    while (takeTask(&task)) {
+      // setTableaus leaves the foundations and free cells alone
+      game.reset();
+      game.setTableaus(*search->tableaus);
+      moveList.clear();
+      startAutoMoves();
+      for (i = 0; i < task.path.size(); i++) {
+        makeMove(&moveList, task.path[i].toCardMove());
+      }
+      frames.clear();
+      moveStack.clear();
+      if (task.moves.empty()) {
+        pushSearchFrame(&frames, &moveStack, task.movesSinceFoundation);
+      }
+      else {
+        moveStack.assign(task.moves.begin(), task.moves.end());
+        frame.firstMove = frame.nextMove = 0;
+        frame.endMove = (unsigned int)moveStack.size();
+        frame.movesSinceFoundation = task.movesSinceFoundation;
+        frame.stage = kStageDone;
+        frames.push_back(frame);
+      }
+
+      if (searchFrames(&moveList, &frames, &moveStack)) {
+        includeAutoMoves(&moveList);
+        lock_guard<mutex> guard(search->solutionLock);
+        if (search->solution.empty()) {
+          search->solution.swap(moveList);
+        }
+        search->finished = true;
+      }
+      search->outstandingTasks.fetch_sub(1);
+    }
+  }
+  catch (bad_alloc&) {
+    // the shared state table or column store filled up; nobody can carry on
+    search->finished = true;
+    if (solveCounts != NULL) {
+      solveCounts->budgetExceeded = true;
+    }
+  }
+
+  if (searchStats.truncated) {
+    search->truncated = true;
+  }
+  flushExpandedNodes();
+  addSearchStats(threadCpuTime() - startCpuTime);
+  game.setColumnStore(NULL);
+  game.reset();
+  sharedStates = NULL;
+  parallelSearch = NULL;
+}
+
+// SearchContext::takeTask
+// Gets the next task for this worker: the newest one in its own queue, or
+// else the oldest one in someone else's. Waits while other workers might
+// still make more; returns false when the search is over.
+bool SearchContext::takeTask(SearchTask* task) {
+  ParallelSearch* search = parallelSearch;
+  bool idle = false;
+  bool found = false;
+  unsigned int i, victim;
+
+  while (!found && !searchCancelled() && search->outstandingTasks.load() > 0) {
+    WorkerQueue& own = search->queues[workerIndex];
+    {
+      lock_guard<mutex> guard(own.lock);
+      if (!own.tasks.empty()) {
+        task->path.swap(own.tasks.back().path);
+        task->moves.swap(own.tasks.back().moves);
+        task->movesSinceFoundation = own.tasks.back().movesSinceFoundation;
+        own.tasks.pop_back();
+        found = true;
+      }
+    }
+    for (i = 1; !found && i < search->workerCount; i++) {
+      victim = (workerIndex + i) % search->workerCount;
+      WorkerQueue& other = search->queues[victim];
+      lock_guard<mutex> guard(other.lock);
+      if (!other.tasks.empty()) {
+        task->path.swap(other.tasks.front().path);
+        task->moves.swap(other.tasks.front().moves);
+        task->movesSinceFoundation = other.tasks.front().movesSinceFoundation;
+        other.tasks.pop_front();
+        found = true;
+      }
+    }
+    if (!found) {
+      if (!idle) {
+        idle = true;
+        search->idleWorkers.fetch_add(1);
+      }
+      this_thread::yield();
+    }
+  }
+  if (idle) {
+    search->idleWorkers.fetch_sub(1);
+  }
+  return found;
+}
+
+// SearchContext::shareWork
+// Moves the untried moves of the shallowest frame that has any into a task
+// on this worker's queue, for an idle worker to steal. The worker always
+// keeps something to do, or a task could be passed around forever without
+// anyone trying a move: from the newest frame it keeps the next move. Does
+// nothing if the queue already has a task waiting.
+void SearchContext::shareWork(const vector<CardMove>& moveList, size_t baseDepth,
+                              vector<SearchFrame>* frames,
+                              const vector<CompactMove>& moveStack) {
+  WorkerQueue& own = parallelSearch->queues[workerIndex];
+  SearchTask task;
+  size_t depth, i;
+  unsigned int firstShared = 0;
+
+  for (depth = 0; depth < frames->size(); depth++) {
+    firstShared = (*frames)[depth].nextMove;
+    if (depth == frames->size() - 1) {
+      firstShared++;
+    }
+    if (firstShared < (*frames)[depth].endMove) {
+      break;
+    }
+  }
+  if (depth == frames->size()) {
+    return;
+  }
+
+  lock_guard<mutex> guard(own.lock);
+  if (!own.tasks.empty()) {
+    return;
+  }
+  SearchFrame& frame = (*frames)[depth];
+  for (i = 0; i < baseDepth + depth; i++) {
+    task.path.push_back(CompactMove(moveList[i]));
+  }
+  task.moves.assign(moveStack.begin() + firstShared, moveStack.begin() + frame.endMove);
+  task.movesSinceFoundation = frame.movesSinceFoundation;
+  frame.endMove = firstShared;
+  parallelSearch->outstandingTasks.fetch_add(1);
+  own.tasks.push_back(task);
+}
+
+// SearchContext::pushSearchFrame
+// Start a new frame for the current position, with its moves on the move
+// stack in the order they should be tried.
+void SearchContext::pushSearchFrame(vector<SearchFrame>* frames, vector<CompactMove>* moveStack,
+                                    unsigned short movesSinceFoundation) {
+  SearchFrame frame;
+
+  frame.firstMove = frame.nextMove = frame.endMove = (unsigned int)moveStack->size();
+  frame.movesSinceFoundation = movesSinceFoundation;
+  frame.stage = kStageFoundation;
+  countExpandedNode();
+  addNextMoveStage(&frame, moveStack);
+  frames->push_back(frame);
+}
+
+// SearchContext::addNextMoveStage
+// Once every move of a frame has been tried, puts the moves of its next
+// stage that has any on the end of the move stack. The frame has to be the
+// newest one; anything on the stack past its end are moves shareWork gave
+// away. Returns false if there were no more to add.
+bool SearchContext::addNextMoveStage(SearchFrame* frame, vector<CompactMove>* moveStack) {
+  MoveBuffer possibleMoves;
+  unsigned int i;
+
+  if (frame->stage == kStageDone) {
+    return false;
+  }
+  moveStack->erase(moveStack->begin() + frame->endMove, moveStack->end());
+  while (frame->stage != kStageDone) {
+    // at the limit only foundation moves are allowed; see searchFrames
+    if (frame->stage == kStageOther && parallelSearch == NULL &&
+        frame->movesSinceFoundation >= maxMovesBetweenFoundationMoves) {
+      frame->stage = kStageDone;
+      searchStats.truncated = true;
+      break;
+    }
+    getMoveStage(&possibleMoves, MoveStage(frame->stage));
+    frame->stage++;
+    if (!possibleMoves.empty()) {
+      DEBUG_LOG(*debugger, kDebugTrace, "Possible move count: " << possibleMoves.size() << endl);
+      for (i = 0; i < possibleMoves.size(); i++) {
+        moveStack->push_back(possibleMoves[i]);
+      }
+      frame->endMove = (unsigned int)moveStack->size();
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// SearchContext::solveFCBestFirst
+// Weighted A*: keeps every position it has reached as a SearchNode and always
+// expands the open node with the lowest depth + weight * estimate. The game
+// only holds one position at a time, so before expanding a node the game is
+// walked over to it from the last node expanded (see switchToNode); the
+// moveList is kept as the path to the current node throughout, which makes
+// it the solution once a solved position turns up.
+// Returns true if the game was solved.
+bool SearchContext::solveFCBestFirst(vector<CardMove>* moveList) {
+  vector<SearchNode> nodes;
+  vector<uint32_t> children, descent;
+  vector<unsigned int> priorities;
+  BucketQueue open;
+  MoveBuffer possibleMoves;
+  SearchNode root = {0, CompactMove(), 0};
+  uint32_t current = 0;
+  size_t i;
+  unsigned int m;
+
+  PositionEvaluator positionEvaluator = settings->positionEvaluator;
+
+  nodes.reserve(kInitialBestFirstNodes);
+  nodes.push_back(root);
+  addStateIfUnseen();
+  open.push(0, 0);
+
+  while (!open.empty()) {
+    if (searchCancelled()) {
+      return false;
+    }
+    switchToNode(moveList, nodes, &current, open.pop(), &descent);
+    countExpandedNode();
+
+    children.clear();
+    priorities.clear();
+    getPossibleMoves(&possibleMoves);
+    for (m = 0; m < possibleMoves.size(); m++) {
+      CardMove curMove = possibleMoves[m].toCardMove();
+      if (filterMove(*moveList, curMove)) {
+        continue; // skip this move
+      }
+      makeMove(moveList, curMove);
+      if (addStateIfUnseen()) {
+        if (game.gameIsSolved()) {
+          return true;
+        }
+        if (isDeadEnd()) {
+          countPrunedPosition();
+          undoMove(moveList, curMove);
+          continue;
+        }
+        SearchNode child = {current, CompactMove(curMove), (unsigned short)(nodes[current].depth + 1)};
+        children.push_back(uint32_t(nodes.size()));
+        nodes.push_back(child);
+        priorities.push_back(child.depth + bestFirstWeight * positionEvaluator(game));
+      }
+      undoMove(moveList, curMove);
+    }
+    // the queue is last in, first out among equals, so push the children
+    // backwards to have the best looking move tried first
+    for (i = children.size(); i > 0; i--) {
+      open.push(priorities[i - 1], children[i - 1]);
+    }
+  }
+  // no solution; leave the game where it started
+  switchToNode(moveList, nodes, &current, 0, &descent);
+  return false;
+}
+
+// SearchContext::switchToNode
+// Brings the game from node *current to node target: undoes moves back to
+// the deepest node both are descended from, then replays the moves from there
+// down to target. descent is scratch space, kept by the caller so it is only
+// allocated once.
+void SearchContext::switchToNode(vector<CardMove>* moveList, const vector<SearchNode>& nodes,
+                                 uint32_t* current, uint32_t target,
+                                 vector<uint32_t>* descent) {
+  uint32_t from = *current, to = target;
+  size_t i;
+
+  descent->clear();
+  while (nodes[from].depth > nodes[to].depth) {
+    undoMove(moveList, moveList->back());
+    from = nodes[from].parent;
+  }
+  while (nodes[to].depth > nodes[from].depth) {
+    descent->push_back(to);
+    to = nodes[to].parent;
+  }
+  while (from != to) {
+    undoMove(moveList, moveList->back());
+    from = nodes[from].parent;
+    descent->push_back(to);
+    to = nodes[to].parent;
+  }
+  for (i = descent->size(); i > 0; i--) {
+    makeMove(moveList, nodes[(*descent)[i - 1]].move.toCardMove());
+  }
+  *current = target;
+}
+
+// evaluatePosition
+// The default position evaluator. Counts the cards still to go to the
+// foundations, the cards covering the next card each foundation needs, and
+// the free cells in use.
+unsigned int evaluatePosition(FreeCellGame& game) {
+  unsigned int estimate = NUM_CARDS;
+  int suit;
+
+  for (suit = 0; suit < NUM_SUITS; suit++) {
+    estimate -= game.nextFoundationRankForSuit(CardSuit(suit)) - 1;
+    if (game.depthOfNextCardInSuit(CardSuit(suit)) > 0) {
+      estimate += game.depthOfNextCardInSuit(CardSuit(suit));
+    }
+  }
+  return estimate + game.getFreeCells().countUsedCells();
+}
+
+
+// SearchContext::getPossibleMoves
+// Get all the possible moves, in some heuristic order that should move the game
+// towards a solution.
+// 8/2/04 I have revised the move selection order to something that is more fine-grained.
+// It is based on a research paper written by two grad students in an AI course.
+// Their names are Kevin Atkinson and Shari Holstege. The paper is locatable online.
+// 8/15/04 Got rid of cumbersome vector storage for moves. Switched to priority queue.
+// The moves go into rankedMoves, which is cleared first, sorted best first.
+void SearchContext::getPossibleMoves(MoveBuffer* rankedMoves) {
+  PhaseSample sample(searchStats, kPhaseMoveGeneration);
+
+  rankedMoves->clear();
+  addFoundationMoves(rankedMoves);
+  addOtherMoves(rankedMoves);
+  rankedMoves->sort();
+  searchStats.movesGenerated += rankedMoves->size();
+}
+
+// SearchContext::getMoveStage
+// Like getPossibleMoves, but only the moves of one stage. The depth-first
+// search asks for the stages one at a time, and usually never gets past the
+// foundation moves.
+void SearchContext::getMoveStage(MoveBuffer* rankedMoves, MoveStage stage) {
+  PhaseSample sample(searchStats, kPhaseMoveGeneration);
+
+  rankedMoves->clear();
+  if (stage == kStageFoundation) {
+    addFoundationMoves(rankedMoves);
+  }
+  else if (stage == kStageOther) {
+    addOtherMoves(rankedMoves);
+  }
+  rankedMoves->sort();
+  searchStats.movesGenerated += rankedMoves->size();
+}
+
+// SearchContext::addFoundationMoves
+// The moves from the tableaus and free cells to the foundations.
+void SearchContext::addFoundationMoves(MoveBuffer* rankedMoves) {
+  unsigned int i;
+  const vector<Tableau>& tableaus = game.getTableaus();
+  const FreeCells& freeCells = game.getFreeCells();
+  unsigned short usedCells = freeCells.countUsedCells();
+
+  // 1. score moves for tableau => foundation
+  for (i = 0; i < kNumTableaus; i++) {
+    if (!tableaus[i].empty()) {
+      const Card& curCard = tableaus[i].top();
+      if (curCard.num == game.nextFoundationRankForSuit(curCard.suit)) {
+        rankedMoves->add(CardMove(curCard, tableauToLoc(i), foundation), moveScores.toFoundation);
+      }
+    }
+  }
+
+  // 1. Add moves for free cells => foundation
+  for (i = 0; i < usedCells; i++) {
+    Card const& curCard = freeCells.get(i);
+    if (curCard.num == game.nextFoundationRankForSuit(curCard.suit)) {
+      rankedMoves->add(CardMove(curCard, cell, foundation), moveScores.toFoundation);
+    }
+  }
+}
+
+// SearchContext::addOtherMoves
+// Every move that doesn't go to a foundation.
+void SearchContext::addOtherMoves(MoveBuffer* rankedMoves) {
+  unsigned int i, j;
+  unsigned int goodOrigins = game.getPreferredMoveOriginMask();
+  unsigned int goodDestinations = game.getPreferredMoveDestinationMask();
+  const vector<Tableau>& tableaus = game.getTableaus();
+  const FreeCells& freeCells = game.getFreeCells();
+  unsigned short usedCells = freeCells.countUsedCells();
+  const Card* topTableauCards[kNumTableaus];
+  // what putting a card on each tableau adds to a move's score
+  long destinationScores[kNumTableaus];
+  long score;
+
+  // get top tableau cards
+  for (i = 0; i < kNumTableaus; i++) {
+    if (tableaus[i].empty()) {
+      topTableauCards[i] = NULL;
+    }
+    else {
+      topTableauCards[i] = &tableaus[i].top();
+    }
+    if (goodDestinations & locationBit(tableauToLoc(i))) {
+      destinationScores[i] = moveScores.toPreferredDestination;
+    }
+    // 8/21/04 added penalty based on how deep the next useful cards are in the tableaus
+    else if (game.depthOfNextFoundationCardForTableau(i) > 0) {
+      destinationScores[i] = -moveScores.penaltyForBuryingCard;
+    }
+    else {
+      destinationScores[i] = 0;
+    }
+  }
+
+  // add moves for free cells => tableau
+  for (i = 0; i < usedCells; i++) {
+    Card const& curCard = freeCells.get(i);
+    for (j = 0; j < kNumTableaus; j++) {
+      score = moveScores.toTableau + moveScores.offFreeCell + destinationScores[j];
+      Location loc = tableauToLoc(j);
+      if (topTableauCards[j] == NULL) {
+        score += moveScores.toEmptyTableauPerRank * curCard.num;
+        rankedMoves->add(CardMove(curCard, cell, loc), score);
+      }
+      else if (canPlaceOnTop(curCard, *topTableauCards[j])) {
+        rankedMoves->add(CardMove(curCard, cell, loc), score);
+      }
+    }
+  }
+
+  // add moves for tableau => different tableau
+  for (i = 0; i < kNumTableaus; i++) {
+    if (topTableauCards[i]) {
+      for (j = 0; j < kNumTableaus; j++) {
+        if (i != j) {
+          score = moveScores.fromTableau + moveScores.toTableau + destinationScores[j];
+          Location originLoc = tableauToLoc(i);
+          Location destLoc = tableauToLoc(j);
+          if (goodOrigins & locationBit(originLoc)) {
+            score += moveScores.fromPreferredOrigin;
+          }
+          if (topTableauCards[j] == NULL) {
+            score += moveScores.toEmptyTableauPerRank * topTableauCards[i]->num;
+            rankedMoves->add(CardMove(*topTableauCards[i], originLoc, destLoc), score);
+          }
+          else if (canPlaceOnTop(*topTableauCards[i], *topTableauCards[j])) {
+            rankedMoves->add(CardMove(*topTableauCards[i], originLoc, destLoc), score);
           }
-          // move is innocuous for the optimization. Continue
         }
       }
     }
-    // done optimization 2
-
-    move = 0;
-    // optimization 3 is theoretically obsolete with the filter in filterMove
-    // careful with unsigned type of size(), don't subtract 1 from it
-    while (move + 1 < moveList->size()) {
-      if (moveList->at(move).card == moveList->at(move + 1).card) {
-        Debug::getDefaultInstance() << "Performing optimization 3 on move " << move + 1 << endl;
-        // note that the 2 moves could put the card back to where it started...and it would
-        // be nonsensical to have a move's origin and destination be the same
-        if (moveList->at(move).from == moveList->at(move + 1).dest) {
-          // obliterate both moves
-          Debug::getDefaultInstance() << "3a" << endl;
-          moveList->erase(moveList->begin() + move, moveList->begin() + move + 2);
+  }
+
+  // add run moves for tableau => different tableau. The top card on its own
+  // was handled above; these move it along with the cards under it that it
+  // is stacked on, as many as the free cells and empty tableaus allow.
+  if (settings->useSupermoves) {
+    int runLimit = game.getRunLimit(false);
+    int emptyRunLimit = game.getRunLimit(true);
+    for (i = 0; i < kNumTableaus; i++) {
+      const Tableau& origin = tableaus[i];
+      int runLength = game.getRunLength(i);
+      if (runLength < 2) {
+        continue;
+      }
+      for (j = 0; j < kNumTableaus; j++) {
+        int length;
+        if (i == j) {
+          continue;
+        }
+        if (topTableauCards[j] == NULL) {
+          // the longest run that fits, unless that is the whole tableau,
+          // which would just swap one tableau for another
+          length = min(runLength, emptyRunLimit);
+          if (length < 2 || length == (int)origin.size()) {
+            continue;
+          }
         }
         else {
-          Debug::getDefaultInstance() << "3b" << endl;
-          moveList->at(move).dest = moveList->at(move + 1).dest;
-          moveList->erase(moveList->begin() + move + 1, moveList->begin() + move + 2);
-          // reexamine the same move because next move might ALSO be this card
+          // the one run length whose bottom card goes on the destination
+          length = topTableauCards[j]->num - topTableauCards[i]->num;
+          if (length < 2 || length > runLength || length > runLimit ||
+              !canPlaceOnTop(origin.peek(origin.size() - length), *topTableauCards[j])) {
+            continue;
+          }
+        }
+        const Card& base = origin.peek(origin.size() - length);
+        score = moveScores.fromTableau + moveScores.toTableau + destinationScores[j];
+        Location originLoc = tableauToLoc(i);
+        Location destLoc = tableauToLoc(j);
+        if (goodOrigins & locationBit(originLoc)) {
+          score += moveScores.fromPreferredOrigin;
         }
+        if (topTableauCards[j] == NULL) {
+          score += moveScores.toEmptyTableauPerRank * base.num;
+        }
+        rankedMoves->add(CardMove(base, originLoc, destLoc), score);
       }
-      else {
-        move++;
+    }
+  }
+
+  // add moves for tableau => free cell
+  // 7/31/01 added randomization
+  if (usedCells < 4) {
+    unsigned char indices[kNumTableaus];
+    getRandomIndices(indices, kNumTableaus, &randomSeed);
+    for (i = 0; i < kNumTableaus; i++) {
+      if (topTableauCards[indices[i]]) {
+        score = moveScores.fromTableau + moveScores.toFreeCell;
+        Location originLoc = tableauToLoc(indices[i]);
+        if (goodOrigins & locationBit(originLoc)) {
+          score += moveScores.fromPreferredOrigin;
+        }
+        rankedMoves->add(CardMove(*topTableauCards[indices[i]], originLoc, cell), score);
       }
     }
-    // done optimization 3
+  }
+}
 
-  } while (moveList->size() < startingMoveCount);
 
-  Debug::getDefaultInstance() << "Final move count: " << moveList->size() << endl;
+// SearchContext::makeMove
+// Makes the move and then whatever auto moves it lets the game play.
+void SearchContext::makeMove(vector<CardMove>* moveList, const CardMove& theMove) {
+  PhaseSample sample(searchStats, kPhaseMakeUndo);
+
+  game.performMove(theMove);
+  moveList->push_back(theMove);
+  autoMoveCounts.push_back((unsigned char)game.playAutoMoves(&autoMoves));
+  if (theMove.dest == foundation || autoMoveCounts.back() > 0) {
+    countFoundationCards(*moveList);
+  }
+  if (moveList->size() > searchStats.maxDepth) {
+    searchStats.maxDepth = (unsigned int)moveList->size();
+  }
 }
 
-void setAppend(int appendValue)
-{
-  append = appendValue;
+
+// SearchContext::undoMove
+// Undoes the last move in moveList, which must be theMove, along with the
+// auto moves that followed it.
+void SearchContext::undoMove(vector<CardMove>* moveList, const CardMove& theMove) {
+  PhaseSample sample(searchStats, kPhaseMakeUndo);
+
+  searchStats.backtracks++;
+  game.undoAutoMoves(&autoMoves, autoMoveCounts.back());
+  autoMoveCounts.pop_back();
+  game.undoMove(theMove);
+  moveList->pop_back();
 }
 
-void setLogPath(const char * path)
+/**
+* filterMove: return a boolean, true if prospectiveMove should be filtered (skipped),
+ * false if it should be performed.
+ * The point of filterMove is to ignore possible moves that are provably asinine.
+ * The filter is allowed to look at past moves and the state of the tableaus.
+ **/
+bool SearchContext::filterMove(const vector<CardMove>& moves, const CardMove& prospectiveMove)
 {
-  logPath = path;
-}
+  if (prospectiveMove.dest == foundation) { // avoid doing stupid things...
+    return false;
+  }
 
-/* validation */
-/* Currently this is only useful if debugging is turned on */
-bool validateSolution(const vector<CardMove>& moves, const vector<Tableau>& tableaus)
+  const vector<Tableau>& tableaus = game.getTableaus();
+
+  // filter moves that take a card off a very "stable" tableau: a tableau based on a king, is stacked
+  // correctly and is 3 or more cards
+  if (isLocTableau(prospectiveMove.from)) {
+    const Tableau& tableau = tableaus[locToTableau(prospectiveMove.from)];
+    if (tableau.peek(0).num == 13 && tableau.size() >= 3) { // if the bottom card is a king...
+      // the game keeps track of how much of the tableau is stacked in order
+      if (game.getRunLength(locToTableau(prospectiveMove.from)) < (int)tableau.size()) {
+        return false; // it's not a perfect stack, move may not be asinine
+      }
+      DEBUG_LOG(*debugger, kDebugTrace, "filtering a move: stable tableau rule" << endl);
+      searchStats.movesFiltered[kFilterStableTableau]++;
+      searchStats.truncated = true;
+      return true;
+    }
+  }
+
+  // filter 2: don't move a card to Location x that is identically stackable to a card that was just moved off of
+  // location x, if x is a tableau. That is asinine.
+  if (isLocTableau(prospectiveMove.dest) && moves.size() > 0) {
+    if (prospectiveMove.dest == moves.back().from && prospectiveMove.card.num == moves.back().card.num &&
+        prospectiveMove.card.hasSuitOfSameColorAs(moves.back().card)) {
+      DEBUG_LOG(*debugger, kDebugTrace, "filtering a move: move equivalent card rule" << endl);
+      searchStats.movesFiltered[kFilterEquivalentCard]++;
+      searchStats.truncated = true;
+      return true;
+    }
+  }
+
+  // filter 3: don't move the same card twice in a row. Moving it straight to
+  // where it ends up, or leaving it, is always among the other moves, so
+  // unlike the first two this one never loses a way out.
+  if (moves.size() > 0 && prospectiveMove.card == moves.back().card) {
+    searchStats.movesFiltered[kFilterSameCardTwice]++;
+    return true;
+  }
+
+  return false;
+}
+
+bool canPlaceOnTop(const Card& c, const Card& target) {
+  return c.num == target.num - 1 &&
+  (((c.suit == clubs || c.suit == spades) &&
+    (target.suit == hearts || target.suit == diamonds)) ||
+   ((c.suit == hearts || c.suit == diamonds) &&
+    (target.suit == clubs || target.suit == spades)));
+}
+
+// getRandomIndices
+template <typename index_type>
+void getRandomIndices(index_type indices[], int n, unsigned int* seed) {
+  int i, j;
+  int rands[kNumTableaus];
+  assert(n <= kNumTableaus);
+  for (i = 0; i < n; i++) {
+    indices[i] = i;
+    rands[i] = rand_r(seed);
+  }
+  // bubble sort
+  for (i = 1; i < n; i++)
+    for (j = 0; j < n - i; j++)
+      if (rands[indices[j]] > rands[indices[j + 1]]) {
+        index_type temp = indices[j];
+        indices[j] = indices[j + 1];
+        indices[j + 1] = temp;
+      }
+}
+
+// The state is packed into a StateKey, which is looked up and added in one
+// probe of the state table, using the hash the game keeps as it goes.
+bool SearchContext::addStateIfUnseen()
+{
+  PhaseSample sample(searchStats, kPhaseDedup);
+  StateKey key;
+  bool added;
+
+  game.getStateKey(&key);
+  if (sharedStates != NULL) {
+    added = sharedStates->insert(key, game.getPositionHash());
+  }
+  else {
+    added = fcStates.insert(key, game.getPositionHash());
+  }
+  if (added) {
+    searchStats.statesAdded++;
+  }
+  else {
+    searchStats.statesSeen++;
+  }
+  return added;
+}
+
+// SearchContext::isDeadEnd
+// True if the game can't be won from the current position. With every free
+// cell full and no empty tableau, the only moves are a card to a foundation,
+// a card from a free cell onto a tableau, and a tableau's top card onto
+// another tableau. Only the last keeps the position without space, so if
+// following those as far as they go never turns up one of the others, or
+// a tableau emptied, nothing ever will. That covers a card buried under
+// higher cards of its own suit with nowhere to put them, and full free
+// cells whose cards have nowhere to go. Gives up, saying no, after looking
+// at kDeadEndProbePositions positions.
+bool SearchContext::isDeadEnd() {
+  uint64_t seen[kDeadEndProbePositions];
+  unsigned int seenCount = 0;
+  bool found;
+
+  if (game.getFreeCells().countUsedCells() < NUM_FREE_CELLS || game.countEmptyTableaus() > 0) {
+    return false;
+  }
+  // the probe's tableaus would otherwise go into the column store, which in
+  // a parallel search is shared and never grows
+  game.beginProbe();
+  found = findWayOut(seen, &seenCount);
+  game.endProbe();
+  return !found;
+}
+
+// SearchContext::findWayOut
+// isDeadEnd's search: true if a move that makes progress or frees up space
+// can be reached from the current position by moving top cards from tableau
+// to tableau, or if it runs out of room in seen to look further. Leaves the
+// game where it found it. The game keeps no state keys while probing, so
+// positions are told apart by their hashes.
+bool SearchContext::findWayOut(uint64_t seen[], unsigned int* seenCount) {
+  const vector<Tableau>& tableaus = game.getTableaus();
+  const FreeCells& freeCells = game.getFreeCells();
+  uint64_t hash = game.getPositionHash();
+  Card tops[kNumTableaus];
+  // stackingBit of every card some tableau would take
+  unsigned int wanted = 0;
+  unsigned int i, j;
+  bool found;
+
+  for (i = 0; i < *seenCount; i++) {
+    if (seen[i] == hash) {
+      return false; // looked at already, or being looked at
+    }
+  }
+  if (*seenCount == kDeadEndProbePositions) {
+    return true;
+  }
+  seen[(*seenCount)++] = hash;
+
+  for (i = 0; i < kNumTableaus; i++) {
+    tops[i] = tableaus[i].top();
+    if (tops[i].num == game.nextFoundationRankForSuit(tops[i].suit)) {
+      return true;
+    }
+    wanted |= wantedStackingBit(tops[i]);
+  }
+  for (i = 0; i < NUM_FREE_CELLS; i++) {
+    Card card = freeCells.get(i);
+    if (card.num == game.nextFoundationRankForSuit(card.suit) ||
+        (wanted & stackingBit(card))) {
+      return true;
+    }
+  }
+  for (i = 0; i < kNumTableaus; i++) {
+    if (!(wanted & stackingBit(tops[i]))) {
+      continue;
+    }
+    if (tableaus[i].size() == 1) {
+      return true;
+    }
+    for (j = 0; j < kNumTableaus; j++) {
+      if (i == j || !canPlaceOnTop(tops[i], tops[j])) {
+        continue;
+      }
+      CardMove move(tops[i], tableauToLoc(i), tableauToLoc(j));
+      game.performMove(move);
+      found = findWayOut(seen, seenCount);
+      game.undoMove(move);
+      if (found) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// a bit for the card's rank and colour; the cards canPlaceOnTop treats alike
+// get the same bit
+static inline unsigned int stackingBit(const Card& card) {
+  return 1u << (card.num * 2 + (card.suit == hearts || card.suit == diamonds));
+}
+
+// the stackingBit of the cards that can go on top of the card
+static inline unsigned int wantedStackingBit(const Card& card) {
+  return 1u << ((card.num - 1) * 2 + (card.suit == clubs || card.suit == spades));
+}
+
+// Solver::optimizeMoves
+// Shortens a solution with three passes, each linear in its length:
+// 1) cutLoops replays it, and wherever the game comes back to a position it
+//    has been in before, cuts out every move in between.
+// 2) dropExcursions takes out a card's move off a tableau and its move
+//    straight back, when nothing else has touched either tableau.
+// 3) mergeMoves turns moves of the same card that follow one another into
+//    one move.
+// None of them can turn a valid solution into an invalid one. Each can open
+// up chances for the others, so they go round again while that pays off;
+// it rarely takes more than two or three rounds.
+void Solver::optimizeMoves(vector<CardMove>* moveList, const vector<Tableau>& tableaus)
+{
+  Debug& debugger = *this->debugger;
+  size_t startingMoveCount;
+
+  DEBUG_LOG(debugger, kDebugInfo, "Optimizing" << endl);
+
+  do {
+    // heed the request to stop, even when optimizing
+    if (stopRequested()) {
+      break;
+    }
+    startingMoveCount = moveList->size();
+    cutLoops(moveList, tableaus, &debugger);
+    dropExcursions(moveList);
+    mergeMoves(moveList);
+  } while (moveList->size() < startingMoveCount);
+
+  DEBUG_LOG(debugger, kDebugInfo, "Final move count: " << moveList->size() << endl);
+}
+
+// cutLoops
+// From each position, carries on from the last time the game is in that
+// position. Positions are compared exactly, tableau by tableau, so the moves
+// after a cut still apply as they are.
+static void cutLoops(vector<CardMove>* moveList, const vector<Tableau>& tableaus,
+                     Debug* debugger)
+{
+  FreeCellGame replay;
+  vector<string> positions(moveList->size() + 1);
+  unordered_map<string, size_t> lastSeen;
+  vector<CardMove> shortened;
+  size_t i;
+
+  replay.setDebug(debugger);
+  replay.setTableaus(tableaus);
+  getExactPosition(replay, &positions[0]);
+  for (i = 0; i < moveList->size(); i++) {
+    replay.performMove((*moveList)[i]);
+    getExactPosition(replay, &positions[i + 1]);
+  }
+  lastSeen.reserve(positions.size());
+  for (i = 0; i < positions.size(); i++) {
+    lastSeen[positions[i]] = i;
+  }
+
+  shortened.reserve(moveList->size());
+  for (i = lastSeen[positions[0]]; i < moveList->size(); i = lastSeen[positions[i + 1]]) {
+    shortened.push_back((*moveList)[i]);
+  }
+  moveList->swap(shortened);
+}
+
+// dropExcursions
+// If a card is moved off a tableau and later moved straight back, and
+// nothing else has touched the tableau, or the tableau the card was on in
+// the meantime, both moves can go: the moves in between only ever had one
+// free cell or empty tableau fewer to work with.
+static void dropExcursions(vector<CardMove>* moveList)
+{
+  vector<CardMove> kept;
+  vector<bool> dropped(moveList->size(), false);
+  int lastMoveOfCard[NUM_CARDS];
+  int lastTouched[kNumTableaus];
+  size_t i;
+
+  fill(lastMoveOfCard, lastMoveOfCard + NUM_CARDS, -1);
+  fill(lastTouched, lastTouched + kNumTableaus, -1);
+  for (i = 0; i < moveList->size(); i++) {
+    const CardMove& move = (*moveList)[i];
+    int& previous = lastMoveOfCard[cardIndex(move.card)];
+    if (previous >= 0 && isLocTableau(move.dest) &&
+        (*moveList)[previous].from == move.dest && (*moveList)[previous].dest == move.from &&
+        lastTouched[locToTableau(move.dest)] == previous &&
+        (!isLocTableau(move.from) || lastTouched[locToTableau(move.from)] == previous)) {
+      dropped[previous] = dropped[i] = true;
+      previous = -1;
+    }
+    else {
+      previous = int(i);
+    }
+    if (isLocTableau(move.from)) {
+      lastTouched[locToTableau(move.from)] = int(i);
+    }
+    if (isLocTableau(move.dest)) {
+      lastTouched[locToTableau(move.dest)] = int(i);
+    }
+  }
+
+  kept.reserve(moveList->size());
+  for (i = 0; i < moveList->size(); i++) {
+    if (!dropped[i]) {
+      kept.push_back((*moveList)[i]);
+    }
+  }
+  moveList->swap(kept);
+}
+
+// mergeMoves
+// A card moved twice in a row, say to a free cell and straight on to a
+// tableau, only needs the one move; none at all if it ends up where it
+// started.
+static void mergeMoves(vector<CardMove>* moveList)
+{
+  vector<CardMove> merged;
+  size_t i;
+
+  merged.reserve(moveList->size());
+  for (i = 0; i < moveList->size(); i++) {
+    const CardMove& move = (*moveList)[i];
+    if (!merged.empty() && merged.back().card == move.card) {
+      merged.back().dest = move.dest;
+      if (merged.back().from == merged.back().dest) {
+        merged.pop_back();
+      }
+    }
+    else {
+      merged.push_back(move);
+    }
+  }
+  moveList->swap(merged);
+}
+
+// Solver::shortenSolution
+// The peephole optimizer. Walks a window of setPeepholeWindow moves along
+// the solution, and for each one looks for a shorter way from the position
+// at its start to any position inside it; when it finds one, the shorter
+// way is spliced in. Stops early once setPeepholeTimeLimit runs out.
+void Solver::shortenSolution(vector<CardMove>* moveList, const vector<Tableau>& tableaus)
+{
+  Debug& debugger = *this->debugger;
+  FreeCellGame replay;
+  chrono::steady_clock::time_point deadline =
+    chrono::steady_clock::now() + chrono::milliseconds(settings.peepholeTimeLimit);
+  bool logging = debugger.isEnabled();
+  size_t start = 0, startingMoveCount = moveList->size();
+
+  if (settings.peepholeWindow < 2) {
+    return;
+  }
+  // the searches try a great many moves that would all be logged
+  debugger.disable();
+  replay.setDebug(&debugger);
+  replay.setTableaus(tableaus);
+  while (start + 1 < moveList->size() && !stopRequested() &&
+         chrono::steady_clock::now() < deadline) {
+    // after a splice, see if the same window can be shortened again
+    if (!shortenWindow(&replay, moveList, start, settings.peepholeWindow, deadline)) {
+      replay.performMove((*moveList)[start]);
+      start++;
+    }
+  }
+  if (logging) {
+    debugger.enable();
+  }
+  DEBUG_LOG(debugger, kDebugInfo, "Peephole optimizer took the solution from " << startingMoveCount
+                                  << " to " << moveList->size() << " moves" << endl);
+}
+
+// shortenWindow
+// A breadth-first search from the position at the start of the window, which
+// is where *replay is, for the positions the solution goes through later in
+// the window. It only moves the cards the solution moves in the window, and
+// gives up after kPeepholeNodesPerWindow positions. Returns true if it
+// spliced a shorter path into moveList.
+static bool shortenWindow(FreeCellGame* replay, vector<CardMove>* moveList, size_t start,
+                          size_t window, chrono::steady_clock::time_point deadline)
+{
+  size_t end = min(moveList->size(), start + window);
+  unordered_map<string, size_t> targets;
+  unordered_set<string> seen;
+  vector<PeepholeNode> nodes;
+  vector<CardMove> path, candidates;
+  bool windowCards[NUM_CARDS] = {false};
+  string position;
+  size_t i, j, bestTarget = 0;
+  uint32_t current, bestNode = 0;
+  int bestSaving = 0;
+
+  // the positions the solution goes through in the window, by how many
+  // moves in they are
+  getExactPosition(*replay, &position);
+  seen.insert(position);
+  for (i = start; i < end; i++) {
+    replay->performMove((*moveList)[i]);
+    windowCards[cardIndex((*moveList)[i].card)] = true;
+    getExactPosition(*replay, &position);
+    targets[position] = i + 1 - start;
+  }
+  for (i = end; i > start; i--) {
+    replay->undoMove((*moveList)[i - 1]);
+  }
+
+  PeepholeNode root = {0, CompactMove(), 0};
+  nodes.push_back(root);
+  for (current = 0; current < nodes.size() && nodes.size() < kPeepholeNodesPerWindow; current++) {
+    unsigned short depth = nodes[current].depth;
+    // its children can only help if they beat the best saving so far
+    if (depth + 1 + bestSaving >= int(end - start)) {
+      break;
+    }
+    if ((current & 0xFF) == 0 && chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+    getPathToPeepholeNode(nodes, current, &path);
+    for (i = 0; i < path.size(); i++) {
+      replay->performMove(path[i]);
+    }
+
+    // every move of a window card that is on top of a tableau or in a cell
+    const vector<Tableau>& tableaus = replay->getTableaus();
+    const FreeCells& freeCells = replay->getFreeCells();
+    candidates.clear();
+    for (i = 0; i < kNumTableaus; i++) {
+      if (tableaus[i].empty() || !windowCards[cardIndex(tableaus[i].top())]) {
+        continue;
+      }
+      const Card& card = tableaus[i].top();
+      if (card.num == replay->nextFoundationRankForSuit(card.suit)) {
+        candidates.push_back(CardMove(card, tableauToLoc(i), foundation));
+      }
+      if (freeCells.countUsedCells() < NUM_FREE_CELLS) {
+        candidates.push_back(CardMove(card, tableauToLoc(i), cell));
+      }
+      for (j = 0; j < kNumTableaus; j++) {
+        if (j != i && (tableaus[j].empty() || canPlaceOnTop(card, tableaus[j].top()))) {
+          candidates.push_back(CardMove(card, tableauToLoc(i), tableauToLoc(j)));
+        }
+      }
+    }
+    for (i = 0; i < freeCells.countUsedCells(); i++) {
+      Card card = freeCells.get(i);
+      if (!windowCards[cardIndex(card)]) {
+        continue;
+      }
+      if (card.num == replay->nextFoundationRankForSuit(card.suit)) {
+        candidates.push_back(CardMove(card, cell, foundation));
+      }
+      for (j = 0; j < kNumTableaus; j++) {
+        if (tableaus[j].empty() || canPlaceOnTop(card, tableaus[j].top())) {
+          candidates.push_back(CardMove(card, cell, tableauToLoc(j)));
+        }
+      }
+    }
+
+    for (i = 0; i < candidates.size(); i++) {
+      replay->performMove(candidates[i]);
+      getExactPosition(*replay, &position);
+      if (seen.insert(position).second) {
+        unordered_map<string, size_t>::const_iterator target = targets.find(position);
+        PeepholeNode child = {current, CompactMove(candidates[i]), (unsigned short)(depth + 1)};
+        if (target != targets.end() && int(target->second) - (depth + 1) > bestSaving) {
+          bestSaving = int(target->second) - (depth + 1);
+          bestTarget = target->second;
+          bestNode = uint32_t(nodes.size());
+        }
+        nodes.push_back(child);
+      }
+      replay->undoMove(candidates[i]);
+    }
+    for (i = path.size(); i > 0; i--) {
+      replay->undoMove(path[i - 1]);
+    }
+  }
+
+  if (bestSaving == 0) {
+    return false;
+  }
+  getPathToPeepholeNode(nodes, bestNode, &path);
+  moveList->erase(moveList->begin() + start, moveList->begin() + start + bestTarget);
+  moveList->insert(moveList->begin() + start, path.begin(), path.end());
+  return true;
+}
+
+// the moves from the start of the window to the node, in order
+static void getPathToPeepholeNode(const vector<PeepholeNode>& nodes, uint32_t node,
+                                  vector<CardMove>* path)
+{
+  path->clear();
+  for (; node != 0; node = nodes[node].parent) {
+    path->push_back(nodes[node].move.toCardMove());
+  }
+  reverse(path->begin(), path->end());
+}
+
+// getExactPosition
+// Describes the position in *position: the cards on each tableau in order,
+// then the cards in the free cells, which can be in any order. Unlike the
+// state key, tableaus in different places make different positions.
+static void getExactPosition(FreeCellGame& game, string* position)
+{
+  const vector<Tableau>& tableaus = game.getTableaus();
+  const FreeCells& freeCells = game.getFreeCells();
+  bool inCells[NUM_CARDS] = {false};
+  size_t i, j;
+
+  position->clear();
+  for (i = 0; i < tableaus.size(); i++) {
+    for (j = 0; j < tableaus[i].size(); j++) {
+      *position += char(cardIndex(tableaus[i].peek(j)) + 1);
+    }
+    *position += char(0);
+  }
+  for (i = 0; i < freeCells.countUsedCells(); i++) {
+    inCells[cardIndex(freeCells.get(i))] = true;
+  }
+  for (i = 0; i < NUM_CARDS; i++) {
+    if (inCells[i]) {
+      *position += char(i + 1);
+    }
+  }
+}
+
+Solver::Solver()
+{
+  debugger = &ownDebug;
+  setDefaults();
+}
+
+Solver::Solver(Debug& debugger)
+{
+  this->debugger = &debugger;
+  setDefaults();
+}
+
+void Solver::setDefaults()
+{
+  settings.parameters = kDefaultSolverParameters;
+  settings.positionEvaluator = evaluatePosition;
+  settings.useSupermoves = true;
+  settings.autoPlayRule = kAutoPlaySafe;
+  settings.peepholeWindow = kDefaultPeepholeWindow;
+  settings.peepholeTimeLimit = kDefaultPeepholeTimeLimit;
+  settings.searchThreads = 0;
+  settings.parallelCapacity = kDefaultParallelCapacity;
+  settings.nodeLimit = 0;
+  settings.timeLimit = 0;
+  settings.tableMemoryLimit = 0;
+  settings.useHugePages = false;
+  settings.progressCallback = NULL;
+  settings.progressContext = NULL;
+  settings.progressInterval = 0;
+  settings.append = false;
+  stopFlag = false;
+  stats = SolverStats();
+  bestLine.clear();
+}
+
+void Solver::requestStop()
+{
+  stopFlag = true;
+}
+
+bool Solver::stopRequested() const
+{
+  return stopFlag.load(memory_order_relaxed);
+}
+
+unsigned long long Solver::getNodesExpanded() const
+{
+  return stats.nodesExpanded;
+}
+
+unsigned long long Solver::getPositionsPruned() const
+{
+  return stats.positionsPruned;
+}
+
+size_t Solver::getTableMemory() const
+{
+  return stats.tableMemory;
+}
+
+const SolverStats& Solver::getStats() const
+{
+  return stats;
+}
+
+const vector<CardMove>& Solver::getBestLine() const
+{
+  return bestLine;
+}
+
+const SolverSettings& Solver::getSettings() const
+{
+  return settings;
+}
+
+void Solver::setParameters(const SolverParameters& parameters)
+{
+  settings.parameters = parameters;
+}
+
+void Solver::setMoveScores(const MoveScores& scores)
+{
+  settings.parameters.scores = scores;
+}
+
+void Solver::setBestFirstWeight(unsigned int weight)
+{
+  settings.parameters.bestFirstWeight = weight;
+}
+
+void Solver::setPositionEvaluator(PositionEvaluator evaluator)
+{
+  settings.positionEvaluator = evaluator != NULL ? evaluator : evaluatePosition;
+}
+
+void Solver::setUseSupermoves(bool use)
+{
+  settings.useSupermoves = use;
+}
+
+void Solver::setAutoPlayRule(AutoPlayRule rule)
+{
+  settings.autoPlayRule = rule;
+}
+
+void Solver::setPeepholeWindow(unsigned int moves)
+{
+  settings.peepholeWindow = moves;
+}
+
+void Solver::setPeepholeTimeLimit(unsigned int milliseconds)
+{
+  settings.peepholeTimeLimit = milliseconds;
+}
+
+void Solver::setSearchThreads(unsigned int threads)
+{
+  settings.searchThreads = threads;
+}
+
+void Solver::setParallelCapacity(size_t positions)
+{
+  settings.parallelCapacity = positions;
+}
+
+void Solver::setNodeLimit(unsigned long long nodes)
+{
+  settings.nodeLimit = nodes;
+}
+
+void Solver::setTimeLimit(unsigned int milliseconds)
+{
+  settings.timeLimit = milliseconds;
+}
+
+void Solver::setTableMemoryLimit(size_t bytes)
+{
+  settings.tableMemoryLimit = bytes;
+}
+
+void Solver::setUseHugePages(bool use)
+{
+  settings.useHugePages = use;
+}
+
+void Solver::setProgressCallback(ProgressCallback callback, void* context,
+                                 unsigned int milliseconds)
+{
+  settings.progressCallback = callback;
+  settings.progressContext = context;
+  settings.progressInterval = milliseconds;
+}
+
+void Solver::setLogPath(const char* path)
+{
+  settings.logPath = path;
+}
+
+void Solver::setAppend(int appendValue)
+{
+  settings.append = appendValue;
+}
+
+Debug& Solver::getDebug()
+{
+  return *debugger;
+}
+
+void Solver::setRandomSeed(unsigned int seed)
+{
+  random.seed(seed);
+}
+
+// defaultSolver
+// The solver behind the free functions. It is made on first use, so it can
+// be used from other files' static initializers.
+static Solver& defaultSolver()
+{
+  static Solver solver(Debug::getDefaultInstance());
+  return solver;
+}
+
+// SearchContext::useParameters
+// Makes the parameters the ones the search runs with.
+void SearchContext::useParameters(const SolverParameters& parameters)
+{
+  moveScores = parameters.scores;
+  maxMovesBetweenFoundationMoves = parameters.maxMovesBetweenFoundationMoves;
+  bestFirstWeight = parameters.bestFirstWeight;
+}
+
+SolveStatus solveFreeCell(vector<CardMove>* moveList, const vector<Tableau>& passedTableaus,
+                          SolveStrategy strategy) {
+  return solveFreeCell(moveList, passedTableaus, getSolverParameters(), strategy);
+}
+
+SolveStatus solveFreeCell(vector<CardMove>* moveList, const vector<Tableau>& passedTableaus,
+                          const SolverParameters& parameters, SolveStrategy strategy) {
+  vector<PortfolioSearch> searches(1);
+
+  searches[0].strategy = strategy;
+  searches[0].seed = rand();
+  searches[0].parameters = parameters;
+  return defaultSolver().solvePortfolio(moveList, passedTableaus, searches);
+}
+
+SolveStatus solveFreeCellPortfolio(vector<CardMove>* moveList,
+                                   const vector<Tableau>& passedTableaus,
+                                   const vector<PortfolioSearch>& searches) {
+  return defaultSolver().solvePortfolio(moveList, passedTableaus, searches);
+}
+
+void getDefaultPortfolio(vector<PortfolioSearch>* searches, unsigned int count) {
+  defaultSolver().setRandomSeed(rand());
+  defaultSolver().getDefaultPortfolio(searches, count);
+}
+
+void setAppend(int appendValue)
+{
+  defaultSolver().setAppend(appendValue);
+}
+
+void setLogPath(const char * path)
+{
+  defaultSolver().setLogPath(path);
+}
+
+void setBestFirstWeight(unsigned int weight)
+{
+  defaultSolver().setBestFirstWeight(weight);
+}
+
+void setPositionEvaluator(PositionEvaluator evaluator)
+{
+  defaultSolver().setPositionEvaluator(evaluator);
+}
+
+void setMoveScores(const MoveScores& scores)
+{
+  defaultSolver().setMoveScores(scores);
+}
+
+const MoveScores& getDefaultMoveScores()
+{
+  return kDefaultMoveScores;
+}
+
+void setSolverParameters(const SolverParameters& parameters)
+{
+  defaultSolver().setParameters(parameters);
+}
+
+SolverParameters getSolverParameters()
+{
+  return defaultSolver().getSettings().parameters;
+}
+
+const SolverParameters& getDefaultSolverParameters()
+{
+  return kDefaultSolverParameters;
+}
+
+// loadSolverParameters
+// Stops at the first line it doesn't understand, leaving the parameters
+// before it set.
+bool loadSolverParameters(const char* path, SolverParameters* parameters)
+{
+  ifstream in(path);
+  string line, name, equals, extra;
+  long value;
+
+  if (!in) {
+    return false;
+  }
+  while (getline(in, line)) {
+    istringstream fields(line.substr(0, line.find('#')));
+    if (!(fields >> name)) {
+      continue; // nothing but space or a comment
+    }
+    if (!(fields >> equals >> value) || equals != "=" || fields >> extra ||
+        !setParameter(parameters, name, value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// setParameter
+// Returns false if there is no parameter by that name, or the value is out
+// of its range.
+static bool setParameter(SolverParameters* parameters, const string& name, long value)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(kScoreNames) / sizeof(kScoreNames[0]); i++) {
+    if (name == kScoreNames[i].name) {
+      parameters->scores.*kScoreNames[i].score = value;
+      return true;
+    }
+  }
+  if (value < 0) {
+    return false;
+  }
+  if (name == "maxMovesBetweenFoundationMoves" && value > 0) {
+    parameters->maxMovesBetweenFoundationMoves = (unsigned int)value;
+  }
+  else if (name == "bestFirstWeight") {
+    parameters->bestFirstWeight = (unsigned int)value;
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+void writeSolverParameters(ostream& out, const SolverParameters& parameters)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(kScoreNames) / sizeof(kScoreNames[0]); i++) {
+    out << kScoreNames[i].name << " = " << parameters.scores.*kScoreNames[i].score << endl;
+  }
+  out << "maxMovesBetweenFoundationMoves = " << parameters.maxMovesBetweenFoundationMoves << endl;
+  out << "bestFirstWeight = " << parameters.bestFirstWeight << endl;
+}
+
+void writeSolverStats(ostream& out, const SolverStats& stats)
+{
+  const char* const kFilterRuleNames[kFilterRuleCount] = {
+    "stableTableau", "equivalentCard", "sameCardTwice"
+  };
+  unsigned int i;
+
+  out << "nodesExpanded = " << stats.nodesExpanded << endl;
+  out << "positionsPruned = " << stats.positionsPruned << endl;
+  out << "movesGenerated = " << stats.movesGenerated << endl;
+  for (i = 0; i < kFilterRuleCount; i++) {
+    out << "movesFiltered." << kFilterRuleNames[i] << " = " << stats.movesFiltered[i] << endl;
+  }
+  out << "statesAdded = " << stats.statesAdded << endl;
+  out << "statesSeen = " << stats.statesSeen << endl;
+  out << "backtracks = " << stats.backtracks << endl;
+  out << "maxDepth = " << stats.maxDepth << endl;
+  out << "bestFoundationCards = " << stats.bestFoundationCards << endl;
+  out << "tableMemory = " << stats.tableMemory << endl;
+  out << "moveGenerationTime = " << stats.moveGenerationTime << endl;
+  out << "dedupTime = " << stats.dedupTime << endl;
+  out << "makeUndoTime = " << stats.makeUndoTime << endl;
+  out << "optimizeTime = " << stats.optimizeTime << endl;
+  out << "validateTime = " << stats.validateTime << endl;
+  out << "cpuTime = " << stats.cpuTime << endl;
+  out << "wallTime = " << stats.wallTime << endl;
+}
+
+// getSolveStatusName
+// How the tools name each status in their output.
+const char* getSolveStatusName(SolveStatus status)
+{
+  switch (status) {
+    case kSolveSolved:
+      return "solved";
+    case kSolveUnsolvable:
+      return "unsolvable";
+    case kSolveExhausted:
+      return "exhausted";
+    case kSolveBudgetExceeded:
+      return "budget_exceeded";
+    case kSolveCancelled:
+      return "cancelled";
+  }
+  return "unknown";
+}
+
+void setNodeLimit(unsigned long long nodes)
+{
+  defaultSolver().setNodeLimit(nodes);
+}
+
+void setTimeLimit(unsigned int milliseconds)
+{
+  defaultSolver().setTimeLimit(milliseconds);
+}
+
+void setTableMemoryLimit(size_t bytes)
+{
+  defaultSolver().setTableMemoryLimit(bytes);
+}
+
+void getBestLine(vector<CardMove>* moves)
+{
+  *moves = defaultSolver().getBestLine();
+}
+
+void setProgressCallback(ProgressCallback callback, void* context, unsigned int milliseconds)
+{
+  defaultSolver().setProgressCallback(callback, context, milliseconds);
+}
+
+unsigned long long getNodesExpanded()
+{
+  return defaultSolver().getNodesExpanded();
+}
+
+unsigned long long getPositionsPruned()
+{
+  return defaultSolver().getPositionsPruned();
+}
+
+SolverStats getSolverStats()
+{
+  return defaultSolver().getStats();
+}
+
+void setSearchThreads(unsigned int threads)
+{
+  defaultSolver().setSearchThreads(threads);
+}
+
+void setParallelCapacity(size_t positions)
+{
+  defaultSolver().setParallelCapacity(positions);
+}
+
+void setUseHugePages(bool use)
+{
+  defaultSolver().setUseHugePages(use);
+}
+
+void setUseSupermoves(bool use)
+{
+  defaultSolver().setUseSupermoves(use);
+}
+
+void setAutoPlayRule(AutoPlayRule rule)
+{
+  defaultSolver().setAutoPlayRule(rule);
+}
+
+void setPeepholeWindow(unsigned int moves)
+{
+  defaultSolver().setPeepholeWindow(moves);
+}
+
+void setPeepholeTimeLimit(unsigned int milliseconds)
+{
+  defaultSolver().setPeepholeTimeLimit(milliseconds);
+}
+
+void optimizeMoves(vector<CardMove>* moveList, const vector<Tableau>& tableaus)
+{
+  defaultSolver().optimizeMoves(moveList, tableaus);
+}
+
+void shortenSolution(vector<CardMove>* moveList, const vector<Tableau>& tableaus)
+{
+  defaultSolver().shortenSolution(moveList, tableaus);
+}
+
+void expandSupermoves(vector<CardMove>* moveList, const vector<Tableau>& tableaus)
+{
+  defaultSolver().expandSupermoves(moveList, tableaus);
+}
+
+bool validateSolution(const vector<CardMove>& moves, const vector<Tableau>& tableaus)
+{
+  return defaultSolver().validateSolution(moves, tableaus);
+}
+
+// Solver::expandSupermoves
+// Replaces each run move in moveList with the single card moves that carry
+// it out through the free cells and empty tableaus, so the solution can be
+// validated and played back one card at a time.
+void Solver::expandSupermoves(vector<CardMove>* moveList, const vector<Tableau>& tableaus)
+{
+  FreeCellGame game;
+  vector<CardMove> singles;
+  size_t i;
+
+  game.setDebug(debugger);
+  game.setTableaus(tableaus);
+  singles.reserve(moveList->size());
+  for (i = 0; i < moveList->size(); i++) {
+    const CardMove& move = (*moveList)[i];
+    if (isLocTableau(move.from) && isLocTableau(move.dest)) {
+      const Tableau& origin = game.getTableaus()[locToTableau(move.from)];
+      int count = 0;
+      while (count < (int)origin.size() && !(origin.peek(origin.size() - 1 - count) == move.card)) {
+        count++;
+      }
+      if (count > 0 && count < (int)origin.size()) {
+        expandRunMove(&game, locToTableau(move.from), locToTableau(move.dest), count + 1, &singles);
+        continue;
+      }
+    }
+    performSingleMove(&game, move, &singles);
+  }
+  moveList->swap(singles);
+}
+
+// expandRunMove
+// Moves the top count cards of tableau from onto tableau to one at a time.
+// Runs that fit through the free cells are parked there; longer ones are
+// split in half, with the top half staged on an empty tableau while the
+// bottom half moves.
+static void expandRunMove(FreeCellGame* game, int from, int to, int count,
+                          vector<CardMove>* singles)
+{
+  const vector<Tableau>& tableaus = game->getTableaus();
+  Card parked[NUM_FREE_CELLS];
+  int openCells = NUM_FREE_CELLS - game->getFreeCells().countUsedCells();
+  int spare, half, i;
+
+  if (count <= openCells + 1) {
+    for (i = 0; i < count - 1; i++) {
+      parked[i] = tableaus[from].top();
+      performSingleMove(game, CardMove(parked[i], tableauToLoc(from), cell), singles);
+    }
+    performSingleMove(game, CardMove(tableaus[from].top(), tableauToLoc(from), tableauToLoc(to)), singles);
+    for (i = count - 2; i >= 0; i--) {
+      performSingleMove(game, CardMove(parked[i], cell, tableauToLoc(to)), singles);
+    }
+    return;
+  }
+
+  for (spare = 0; spare < kNumTableaus; spare++) {
+    if (spare != from && spare != to && tableaus[spare].empty()) {
+      break;
+    }
+  }
+  if (spare == kNumTableaus) {
+    // more than getRunLimit allows; leave it for validation to report
+    performSingleMove(game, CardMove(tableaus[from].peek(tableaus[from].size() - count),
+                                     tableauToLoc(from), tableauToLoc(to)), singles);
+    return;
+  }
+  half = (count + 1) / 2;
+  expandRunMove(game, from, spare, half, singles);
+  expandRunMove(game, from, to, count - half, singles);
+  expandRunMove(game, spare, to, half, singles);
+}
+
+static void performSingleMove(FreeCellGame* game, const CardMove& move,
+                              vector<CardMove>* singles)
+{
+  game->performMove(move);
+  singles->push_back(move);
+}
+
+/* validation */
+/* Currently this is only useful if debugging is turned on */
+bool Solver::validateSolution(const vector<CardMove>& moves, const vector<Tableau>& tableaus)
 {
   FreeCellGame game;
+  game.setDebug(debugger);
   game.setTableaus(tableaus);
   bool valid = true;
 
@@ -648,8 +2624,9 @@ bool validateSolution(const vector<CardMove>& moves, const vector<Tableau>& tabl
       locString(&fromname, theMove.from);
 
       valid = false;
-      Debug::getDefaultInstance() << "Move " << i + 1 << " in the solution is not valid";
-      Debug::getDefaultInstance() <<  " (move " << theMove.card.num << " of " << suitname << " from " << fromname << " to " << destname << ")" << endl;
+      DEBUG_LOG(*debugger, kDebugError, "Move " << i + 1 << " in the solution is not valid"
+                << " (move " << theMove.card.num << " of " << suitname << " from " << fromname
+                << " to " << destname << ")" << endl);
     }
   }
   return valid;
@@ -685,6 +2662,6 @@ void locString(char** locStrPtr, Location loc) {
 
 void requestStopForSolverThread() {
 #ifdef SOLVEFREECELL_LIB_THREADED
-  stopRequested = true;
+  defaultSolver().requestStop();
 #endif
 }
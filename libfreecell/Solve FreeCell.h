@@ -26,6 +26,8 @@
 #include <string>
 #include <queue>
 #include <functional>
+#include <atomic>
+#include <random>
 
 // C includes
 #include <assert.h>
@@ -36,8 +38,12 @@
 #include "Tableau.h"
 #include "CardMove.h"
 #include "Debug.h"
+#include "FreeCellGame.h"
 #include "FreeCells.h"
-#include "MoveScorePair.h"
+#include "MoveBuffer.h"
+#include "StateTable.h"
+#include "CompactMove.h"
+#include "BucketQueue.h"
 
 using std::set;
 using std::vector;
@@ -51,7 +57,44 @@ using std::less;
 enum {
 		kFoundationFull = 13,
 		kNumTableaus = 8,
-		kMaxMovesBetweenFoundationMoves = 20
+		kDefaultMaxMovesBetweenFoundationMoves = 20,
+		kInitialSearchDepth = 256,
+		kInitialBestFirstNodes = 1 << 16,
+		kDefaultBestFirstWeight = 6,
+		kDefaultParallelCapacity = 1 << 22,
+		kDefaultPeepholeWindow = 8,
+		kDefaultPeepholeTimeLimit = 250, // milliseconds
+		kPeepholeNodesPerWindow = 1 << 10,
+		kStatsSampleInterval = 64 // a power of two; see SolverStats
+};
+
+// the ways solveFreeCell can search for a solution
+enum SolveStrategy {
+		// backtracking, trying the best looking move from each position first
+		kStrategyDepthFirst,
+		// always carry on from the most promising position seen so far, as
+		// judged by the position evaluator; see setBestFirstWeight
+		kStrategyBestFirst,
+		// the depth-first search split between threads, which share the
+		// positions they have seen; see setSearchThreads
+		kStrategyParallelDepthFirst
+};
+
+// why a solve returned
+enum SolveStatus {
+		kSolveSolved,
+		// a search tried every move there was and found no way out, which
+		// proves the deal can't be won
+		kSolveUnsolvable,
+		// the searches ran out of positions to try, but only having passed
+		// over moves, by filterMove's heuristic rules or the depth-first
+		// search's limit on moves between foundation moves; the deal may
+		// still be won
+		kSolveExhausted,
+		// the solve went over its node, time or table memory limit
+		kSolveBudgetExceeded,
+		// requestStop was called
+		kSolveCancelled
 };
 
 const int INDEX_TO_CHANGE_FROM_NEWLINE_TO_SPACE_FROM_CTIME = 24;
@@ -61,21 +104,465 @@ const int LOG_MODE_APPEND = 0; // TODO: unify with FCSLogModeAppend
 ///////////////////////////////////////////////////////////////////////////////
 // Types
 // The state of a FreeCell game can be completely defined by the cards on the
-// eight tableaus, and the cards in the free cells.
-// We organize this information by maintaining a function
-// f(tableau description) => { all sets of cards that have been in the free cells }
-typedef map<set<Tableau>, set< set<Card> > > FreeCellStates;
+// eight tableaus, and the cards in the free cells. The states seen so far are
+// kept in a StateTable, keyed by FreeCellGame::getStateKey.
+
+// The batches getMoveStage hands out, in the order the depth-first search
+// tries them.
+enum MoveStage {
+  kStageFoundation, // tableau and free cell => foundation
+  kStageOther,      // everything else
+  kStageDone
+};
+
+// One level of the depth-first search: the moves from a position are
+// moveStack[firstMove, endMove), and nextMove is the next one to try. Once
+// they run out, the moves of the next stage go on the end.
+struct SearchFrame {
+  unsigned int firstMove, nextMove, endMove;
+  unsigned short movesSinceFoundation;
+  unsigned char stage; // the next stage to generate
+};
+
+// A position reached by the best-first search, stored as the move that
+// reached it from its parent. Node 0 is the starting position.
+struct SearchNode {
+  uint32_t parent;
+  CompactMove move;
+  unsigned short depth;
+};
+
+// estimates how many moves the game is from being solved; lower is better
+typedef unsigned int (*PositionEvaluator)(FreeCellGame& game);
+
+// How getPossibleMoves ranks the moves it finds; higher scores are tried
+// first.
+struct MoveScores {
+  long toFoundation;
+  long offFreeCell;
+  long toTableau;
+  long fromTableau;
+  long toFreeCell;
+  long toEmptyTableauPerRank;
+  long fromPreferredOrigin;
+  long toPreferredDestination;
+  long penaltyForBuryingCard;
+};
+
+// Everything that steers a search, in one place so a set of them can be
+// tuned, saved and loaded; see loadSolverParameters.
+struct SolverParameters {
+  MoveScores scores;
+  // once the depth-first search has gone this many moves without one to the
+  // foundations, it only tries foundation moves
+  unsigned int maxMovesBetweenFoundationMoves;
+  unsigned int bestFirstWeight; // see setBestFirstWeight
+};
+
+// One of the searches solveFreeCellPortfolio races against the others.
+struct PortfolioSearch {
+  SolveStrategy strategy;
+  unsigned int seed; // shuffles the order moves to free cells are tried in
+  SolverParameters parameters;
+};
+
+// the rules filterMove skips moves by, in the order it tries them
+enum FilterRule {
+  kFilterStableTableau,  // a card off a king-based run of three or more
+  kFilterEquivalentCard, // back where a card of the same rank and colour left
+  kFilterSameCardTwice,  // the card the last move moved
+  kFilterRuleCount
+};
+
+// What a solve did, over every thread it used; see Solver::getStats. The
+// searches count into plain per-thread counters and add them in as they
+// finish. The three search phase times are sampled, one call in
+// kStatsSampleInterval timed and scaled up, so they are estimates; the rest
+// are measured. Times are in seconds.
+struct SolverStats {
+  unsigned long long nodesExpanded;
+  // positions dropped as dead ends; see Solver::getPositionsPruned
+  unsigned long long positionsPruned;
+  unsigned long long movesGenerated;
+  unsigned long long movesFiltered[kFilterRuleCount];
+  // positions the searches put in their state tables, and positions they
+  // reached again and found there already
+  unsigned long long statesAdded;
+  unsigned long long statesSeen;
+  // moves the searches took back
+  unsigned long long backtracks;
+  // the most moves deep any search went
+  unsigned int maxDepth;
+  // the most cards any search had on the foundations at once
+  unsigned int bestFoundationCards;
+  size_t tableMemory; // see Solver::getTableMemory
+  double moveGenerationTime; // getPossibleMoves and getMoveStage
+  double dedupTime;          // addStateIfUnseen
+  double makeUndoTime;       // makeMove and undoMove
+  double optimizeTime;       // everything after the search that shortens
+  double validateTime;
+  // CPU time of every thread the solve ran on, and the time it took
+  double cpuTime;
+  double wallTime;
+};
+
+// the parts of a search SolverStats times by sampling
+enum SearchPhase {
+  kPhaseMoveGeneration,
+  kPhaseDedup,
+  kPhaseMakeUndo,
+  kPhaseCount
+};
+
+// What one search has counted so far, with no locking or atomics; it is
+// added to the solve's stats when the search is over.
+struct SearchStats {
+  unsigned long long movesGenerated;
+  unsigned long long movesFiltered[kFilterRuleCount];
+  unsigned long long statesAdded;
+  unsigned long long statesSeen;
+  unsigned long long backtracks;
+  unsigned int maxDepth;
+  // the most cards the search has had on the foundations, and the moves,
+  // auto moves included, that got it there
+  unsigned int bestFoundationCards;
+  vector<CardMove> bestLine;
+  // whether the search passed over a move that might have led somewhere,
+  // so that running out of moves proves nothing
+  bool truncated;
+  // calls to each phase, which pick the ones to time, and the time the timed
+  // ones took, already scaled up to stand for the rest
+  unsigned int phaseCalls[kPhaseCount];
+  unsigned long long phaseNanoseconds[kPhaseCount];
+};
+
+// How a solve is getting on, as a progress callback is told it. The depth,
+// foundation cards and table size are those of the search that happened to
+// be due to report, on a solve running several.
+struct SolverProgress {
+  unsigned long long nodesExpanded; // over every thread of the solve
+  double nodesPerSecond;
+  double elapsedTime; // seconds since the solve started
+  // the moves the search is into the deal
+  unsigned int depth;
+  // the most cards it has had on the foundations at once
+  unsigned int bestFoundationCards;
+  // the positions in its state table
+  size_t tableSize;
+};
+
+// see Solver::setProgressCallback
+typedef void (*ProgressCallback)(const SolverProgress& progress, void* context);
+
+// Everything a Solver can be told; see its setters.
+struct SolverSettings {
+  SolverParameters parameters;
+  PositionEvaluator positionEvaluator;
+  bool useSupermoves;
+  AutoPlayRule autoPlayRule;
+  unsigned int peepholeWindow;
+  unsigned int peepholeTimeLimit; // milliseconds
+  unsigned int searchThreads;
+  size_t parallelCapacity;
+  unsigned long long nodeLimit;
+  unsigned int timeLimit; // milliseconds
+  size_t tableMemoryLimit; // bytes
+  bool useHugePages;
+  ProgressCallback progressCallback;
+  void* progressContext;
+  unsigned int progressInterval; // milliseconds
+  int append;
+  std::string logPath;
+};
+
+/**
+ * Solves deals with its own settings, log and random numbers, so separate
+ * Solvers can be solving at the same time on different threads, or one
+ * inside another's progress callback. A Solver solves one deal at a time,
+ * though its searches may spread over threads of their own; each search
+ * works in a SearchContext of its own.
+ **/
+class Solver {
+public:
+  Solver();
+  // logs to debugger, which must outlive the solver, instead of a Debug of
+  // the solver's own
+  explicit Solver(Debug& debugger);
+
+  // Runs one search in the calling thread, with the solver's parameters.
+  // Returns why it stopped; moveList is only filled in if it was solved.
+  SolveStatus solve(vector<CardMove>* moveList, const vector<Tableau>& tableaus,
+                    SolveStrategy strategy = kStrategyDepthFirst);
+  // Runs each of the searches on its own thread, and takes the solution from
+  // whichever finishes first; the others are stopped as soon as it does.
+  SolveStatus solvePortfolio(vector<CardMove>* moveList, const vector<Tableau>& tableaus,
+                             const vector<PortfolioSearch>& searches);
+  // fills in count searches that differ in strategy, seed, weight and scores,
+  // based on the solver's parameters
+  void getDefaultPortfolio(vector<PortfolioSearch>* searches, unsigned int count);
+
+  // Asks a solve in progress, on any thread, to give up; it returns with no
+  // solution. The request is cleared when the solve returns.
+  void requestStop();
+  bool stopRequested() const;
+
+  // the number of positions the last solve expanded, over all the threads it
+  // used
+  unsigned long long getNodesExpanded() const;
+  // the number of positions the last solve dropped as dead ends: positions
+  // it could show there was no way to win from
+  unsigned long long getPositionsPruned() const;
+  // the bytes the position tables of the last solve grew to, added up over
+  // the searches it ran
+  size_t getTableMemory() const;
+  // everything the last solve counted and timed
+  const SolverStats& getStats() const;
+  // The moves from the deal to the position with the most cards on the
+  // foundations that the last solve reached, one card at a time; the
+  // solution, if it found one.
+  const vector<CardMove>& getBestLine() const;
+
+  const SolverSettings& getSettings() const;
+  // the scores, the best-first weight and the move limit in one go
+  void setParameters(const SolverParameters& parameters);
+  void setMoveScores(const MoveScores& scores);
+  // the best-first search ranks a position by its depth plus weight times the
+  // evaluator's estimate; higher weights find solutions faster but longer
+  void setBestFirstWeight(unsigned int weight);
+  // NULL restores evaluatePosition
+  void setPositionEvaluator(PositionEvaluator evaluator);
+  // let the searches move a properly stacked run of cards from tableau to
+  // tableau as one move; on by default
+  void setUseSupermoves(bool use);
+  // which foundation moves the searches play as soon as they can, without
+  // trying anything else first; kAutoPlaySafe by default. They still appear
+  // in the solution.
+  void setAutoPlayRule(AutoPlayRule rule);
+  // how many moves of the solution the peephole optimizer tries to shorten
+  // at a time; below 2 turns it off
+  void setPeepholeWindow(unsigned int moves);
+  // how long the peephole optimizer may spend on one solution
+  void setPeepholeTimeLimit(unsigned int milliseconds);
+  // the number of threads kStrategyParallelDepthFirst uses; 0, the default,
+  // means one per core
+  void setSearchThreads(unsigned int threads);
+  // how many positions the parallel search can remember. Its table is set
+  // up at this size from the start, and is not grown; a search that fills
+  // it gives up, as though over its table memory limit.
+  void setParallelCapacity(size_t positions);
+  // searches give up once they have expanded this many positions between
+  // them; 0, the default, means no limit
+  void setNodeLimit(unsigned long long nodes);
+  // searches give up once the solve has been going this long; 0, the
+  // default, means no limit. The optimizer's time comes on top; see
+  // setPeepholeTimeLimit.
+  void setTimeLimit(unsigned int milliseconds);
+  // searches give up once their position tables take up more than this
+  // between them; 0, the default, means no limit. A table grows by doubling,
+  // so it can go over by one step before the search notices.
+  void setTableMemoryLimit(size_t bytes);
+  // back the state table with huge pages where the system supports them
+  void setUseHugePages(bool use);
+  // Has the searches call callback, with context, at most once every
+  // milliseconds while they run; NULL, the default, turns it off. It is
+  // called on whichever search thread is due, which is the solving thread
+  // unless the solve uses more than one, and never on two at once. The
+  // search stops while it runs, so it should be quick; to give up on the
+  // deal, have it call requestStop.
+  void setProgressCallback(ProgressCallback callback, void* context,
+                           unsigned int milliseconds);
+  // While the log is enabled, each solve writes it to the file at path,
+  // after what is there already if append is LOG_MODE_APPEND.
+  void setLogPath(const char* path);
+  void setAppend(int appendValue);
+  Debug& getDebug();
+  // seeds the random numbers the solver hands its searches
+  void setRandomSeed(unsigned int seed);
+
+  // cuts the detours out of a solution for the given deal
+  void optimizeMoves(vector<CardMove>* moveList, const vector<Tableau>& tableaus);
+  // swaps stretches of the solution for shorter ones found by searching from
+  // the start of each stretch; see setPeepholeWindow
+  void shortenSolution(vector<CardMove>* moveList, const vector<Tableau>& tableaus);
+  // turns the run moves in a solution back into single card moves
+  void expandSupermoves(vector<CardMove>* moveList, const vector<Tableau>& tableaus);
+  bool validateSolution(const vector<CardMove>& moves, const vector<Tableau>& tableaus);
+
+private:
+  Solver(const Solver&);
+  Solver& operator=(const Solver&);
+  void setDefaults();
+
+  SolverSettings settings;
+  Debug ownDebug;
+  Debug* debugger;
+  std::minstd_rand random;
+  std::atomic<bool> stopFlag;
+  SolverStats stats;
+  vector<CardMove> bestLine;
+};
+
+// the parts of a solve its searches share; see Solve FreeCell.cpp
+struct SolveCounts;
+struct ParallelSearch;
+struct SearchTask;
+
+/**
+ * One search and everything it works with: the game, the positions it has
+ * seen, the parameters it runs with and what it has counted. Whoever starts
+ * a search makes its context and calls into it, so nothing of one search is
+ * shared with another or outlives its context; the settings and the log are
+ * the solver's. A context is for one thread at a time, and holds one search
+ * at a time.
+ **/
+class SearchContext {
+public:
+  // for the default solver the functions below Solver work on
+  SearchContext();
+  explicit SearchContext(Solver& solver);
+
+  // Solves the game from scratch in the calling thread with the given search
+  // settings. Returns true if it was solved, with the solution in moveList.
+  bool runSearch(vector<CardMove>* moveList, const vector<Tableau>& tableaus,
+                 const PortfolioSearch& search);
+  // Puts the search at the position the moves reach from the deal, with its
+  // auto moves played and an empty state table, as though it had just got
+  // there; getPossibleMoves, makeMove and addStateIfUnseen carry on from
+  // it. For tools that time those pieces on their own. Returns false if one
+  // of the moves isn't legal.
+  bool setSearchPosition(const vector<Tableau>& tableaus, const vector<CardMove>& moves);
+  bool solveFCIterative(vector<CardMove>* moveList);
+  bool searchFrames(vector<CardMove>* moveList, vector<SearchFrame>* frames,
+                    vector<CompactMove>* moveStack);
+  bool solveFCParallel(vector<CardMove>* moveList, const vector<Tableau>& tableaus,
+                       const PortfolioSearch& portfolioSearch);
+  void pushSearchFrame(vector<SearchFrame>* frames, vector<CompactMove>* moveStack,
+                       unsigned short movesSinceFoundation);
+  bool addNextMoveStage(SearchFrame* frame, vector<CompactMove>* moveStack);
+  bool solveFCBestFirst(vector<CardMove>* moveList);
+  void switchToNode(vector<CardMove>* moveList, const vector<SearchNode>& nodes,
+                    uint32_t* current, uint32_t target, vector<uint32_t>* descent);
+
+  void getPossibleMoves(MoveBuffer* rankedMoves);
+  void getMoveStage(MoveBuffer* rankedMoves, MoveStage stage);
+  void makeMove(vector<CardMove>* moves, const CardMove& move);
+  void undoMove(vector<CardMove>* moves, const CardMove& move);
+  bool filterMove(const vector<CardMove>& moves, const CardMove& prospectiveMove);
+  // records the current state; returns true if it had not been seen before
+  bool addStateIfUnseen();
+
+private:
+  friend class Solver;
+
+  // For the searches of a solve: runs with settings, counts into counts,
+  // and gives up once *finished is set, if finished isn't NULL.
+  SearchContext(Solver& solver, const SolverSettings& settings, SolveCounts* counts,
+                std::atomic<bool>* finished);
+  SearchContext(const SearchContext&);
+  SearchContext& operator=(const SearchContext&);
+  void init(Solver& solver, const SolverSettings& settings, SolveCounts* counts,
+            std::atomic<bool>* finished);
+
+  static void runPortfolioSearch(vector<CardMove>* moveList, const vector<Tableau>* tableaus,
+                                 const PortfolioSearch* search, int index,
+                                 std::atomic<bool>* finished, std::atomic<int>* winner,
+                                 Solver* solver, const SolverSettings* settings,
+                                 SolveCounts* counts);
+  static void runParallelWorker(ParallelSearch* search, int index);
+  void runWorker(ParallelSearch* search, int index);
+  bool takeTask(SearchTask* task);
+  void shareWork(const vector<CardMove>& moveList, size_t baseDepth,
+                 vector<SearchFrame>* frames, const vector<CompactMove>& moveStack);
+  void useParameters(const SolverParameters& parameters);
+  void startAutoMoves();
+  void addFoundationMoves(MoveBuffer* rankedMoves);
+  void addOtherMoves(MoveBuffer* rankedMoves);
+  void includeAutoMoves(vector<CardMove>* moveList);
+  void getLineWithAutoMoves(const vector<CardMove>& moveList, vector<CardMove>* line);
+  bool searchCancelled();
+  void countExpandedNode();
+  void flushExpandedNodes();
+  void countPrunedPosition();
+  void countTableMemory(size_t bytes);
+  void reportProgress();
+  void checkBudgets();
+  void countFoundationCards(const vector<CardMove>& moveList);
+  void resetSearchStats();
+  void addSearchStats(double cpuTime);
+  bool isDeadEnd();
+  bool findWayOut(uint64_t seen[], unsigned int* seenCount);
+
+  Solver* solver;
+  const SolverSettings* settings;
+  Debug* debugger;
+  StateTable fcStates;
+  FreeCellGame game;
+  MoveScores moveScores;
+  unsigned int bestFirstWeight;
+  unsigned int maxMovesBetweenFoundationMoves;
+  unsigned int randomSeed;
+  // the foundation moves the game played by itself, and how many it played
+  // after each move in the move list; the first count is for the starting
+  // position. The move list only holds the moves the search chose, so its
+  // length stays the search depth.
+  vector<CardMove> autoMoves;
+  vector<unsigned char> autoMoveCounts;
+  SearchStats searchStats;
+  // the counts of the solve the search is part of, if any. The search counts
+  // its own expanded positions in unflushedNodes and adds them in every
+  // kNodeFlushInterval; pruning is rare enough to add in straight away.
+  SolveCounts* solveCounts;
+  unsigned int unflushedNodes;
+  // set while the search is one of a portfolio
+  std::atomic<bool>* portfolioFinished;
+  // set while the search is a worker in a parallel search, which shares one
+  // table between its workers
+  ParallelSearch* parallelSearch;
+  int workerIndex;
+  StateTable* sharedStates;
+};
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // prototypes
-void solveFreeCell(vector<CardMove>* moveList, const vector<Tableau>& passedTableaus);
-void solveFCRec(vector<CardMove>* moveList, unsigned short myCount = 0);
 
-priority_queue<MoveScorePair> getPossibleMoves();
-void makeMove(vector<CardMove>* moves, const CardMove& move);
-void undoMove(vector<CardMove>* moves, const CardMove& move);
-bool filterMove(const vector<CardMove>& moves, const CardMove& prospectiveMove);
+// These work on a default Solver shared by the whole process, which logs to
+// Debug's default instance; see Solver for what each does. The seeds they
+// give the searches come from rand(), so seed it first.
+SolveStatus solveFreeCell(vector<CardMove>* moveList, const vector<Tableau>& passedTableaus,
+                          SolveStrategy strategy = kStrategyDepthFirst);
+// the same, with the given parameters instead of the current settings
+SolveStatus solveFreeCell(vector<CardMove>* moveList, const vector<Tableau>& passedTableaus,
+                          const SolverParameters& parameters,
+                          SolveStrategy strategy = kStrategyDepthFirst);
+SolveStatus solveFreeCellPortfolio(vector<CardMove>* moveList,
+                                   const vector<Tableau>& passedTableaus,
+                                   const vector<PortfolioSearch>& searches);
+void getDefaultPortfolio(vector<PortfolioSearch>* searches, unsigned int count);
+void setAppend(int appendValue);
+void setLogPath(const char * path);
+void setUseHugePages(bool use);
+void setBestFirstWeight(unsigned int weight);
+void setPositionEvaluator(PositionEvaluator evaluator);
+void setMoveScores(const MoveScores& scores);
+void setSearchThreads(unsigned int threads);
+void setParallelCapacity(size_t positions);
+void setSolverParameters(const SolverParameters& parameters);
+SolverParameters getSolverParameters();
+void setNodeLimit(unsigned long long nodes);
+void setTimeLimit(unsigned int milliseconds);
+void setTableMemoryLimit(size_t bytes);
+void getBestLine(vector<CardMove>* moves);
+void setProgressCallback(ProgressCallback callback, void* context, unsigned int milliseconds);
+unsigned long long getNodesExpanded();
+unsigned long long getPositionsPruned();
+SolverStats getSolverStats();
+void setUseSupermoves(bool use);
+void setAutoPlayRule(AutoPlayRule rule);
+void setPeepholeWindow(unsigned int moves);
+void setPeepholeTimeLimit(unsigned int milliseconds);
+
+unsigned int evaluatePosition(FreeCellGame& game);
 
 inline unsigned short locToTableau(Location loc)
 {
@@ -91,20 +578,32 @@ inline bool isLocTableau(Location loc)
 }
 
 bool canPlaceOnTop(const Card& toBeOnTop, const Card& target);
-template<typename index_type> void getRandomIndices(index_type indices[], int n);
+// shuffles 0..n-1 into indices, drawing on *seed as rand_r does
+template<typename index_type> void getRandomIndices(index_type indices[], int n,
+                                                    unsigned int* seed);
 
-void addState();
-bool seenCurrentState();
+void optimizeMoves(vector<CardMove>* moveList, const vector<Tableau>& tableaus);
+void shortenSolution(vector<CardMove>* moveList, const vector<Tableau>& tableaus);
+void expandSupermoves(vector<CardMove>* moveList, const vector<Tableau>& tableaus);
 
-void optimizeMoves(vector<CardMove>* moveList);
-
-void setAppend(int appendValue);
-void setLogPath(const char * path);
+const MoveScores& getDefaultMoveScores();
+const SolverParameters& getDefaultSolverParameters();
+// Reads "name = value" lines, as writeSolverParameters writes them, into
+// *parameters; anything the file leaves out keeps its value. Blank lines and
+// everything after a '#' are ignored. Returns false if the file can't be
+// read or holds a line that isn't a known parameter.
+bool loadSolverParameters(const char* path, SolverParameters* parameters);
+void writeSolverParameters(std::ostream& out, const SolverParameters& parameters);
+// writes the stats as "name = value" lines, for logs and reports
+void writeSolverStats(std::ostream& out, const SolverStats& stats);
+// the status as a word, such as "solved" or "budget_exceeded"
+const char* getSolveStatusName(SolveStatus status);
 
 bool validateSolution(const vector<CardMove>& moves, const vector<Tableau>& tableaus);
 
 void suitString(char** suitStr, CardSuit suit);
 void locString(char** locStrPtr, Location loc);
+// asks the default solver to stop; see Solver::requestStop
 void requestStopForSolverThread();
 
 //#ifdef SOLVEFREECELL_LIB_THREADED
@@ -0,0 +1,44 @@
+// StateKey.h
+// A canonical, fixed-size encoding of a FreeCell position.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef STATEKEY_H
+#define STATEKEY_H
+
+#include <string.h>
+#include <stdint.h>
+#include "ColumnStore.h"
+
+/**
+ * A position is the IDs of its 8 tableaus, as given by a ColumnStore, sorted;
+ * the cards in the free cells as codes 1..52, sorted, with 0 for an empty
+ * cell; and the foundation ranks. Sorting makes the key the same however the
+ * tableaus and free cells are ordered. Keys are only comparable when their
+ * column IDs come from the same ColumnStore.
+ **/
+struct StateKey {
+  ColumnId columns[8];
+  unsigned char freeCells[4];
+  unsigned char foundations[4];
+
+  bool operator == (const StateKey& rhs) const {
+    return memcmp(this, &rhs, sizeof(StateKey)) == 0;
+  }
+};
+
+#endif // STATEKEY_H
@@ -0,0 +1,248 @@
+// StateTable.cpp
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "StateTable.h"
+#include <sys/mman.h>
+#ifdef __APPLE__
+#include <mach/vm_statistics.h>
+#endif
+#include <new>
+
+using namespace std;
+
+enum {
+  kInitialBucketCount = 1 << 9
+};
+
+const size_t kHugePageSize = 2 * 1024 * 1024;
+
+// marks a slot in a shared table whose key is still being written; real tags
+// are always odd
+const uint64_t kBusyTag = 2;
+
+// Get zeroed memory for the table straight from the system. With hugePages,
+// try for 2MB pages, which saves most of the TLB misses on a big table, and
+// quietly fall back to normal pages when they are not available.
+static void* allocateTableMemory(size_t* bytes, bool hugePages)
+{
+  void* memory;
+
+  if (hugePages) {
+    *bytes = (*bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+#if defined(__APPLE__) && defined(VM_FLAGS_SUPERPAGE_SIZE_2MB)
+    memory = mmap(NULL, *bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+                  VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+    if (memory != MAP_FAILED) {
+      return memory;
+    }
+#endif
+  }
+  memory = mmap(NULL, *bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (memory == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+#ifdef MADV_HUGEPAGE
+  if (hugePages) {
+    madvise(memory, *bytes, MADV_HUGEPAGE);
+  }
+#endif
+  return memory;
+}
+
+static void freeTableMemory(void* memory, size_t bytes)
+{
+  if (memory != NULL) {
+    munmap(memory, bytes);
+  }
+}
+
+StateTable::StateTable()
+{
+  buckets = NULL;
+  keys = NULL;
+  bucketCount = 0;
+  bucketShift = 64;
+  count = 0;
+  maxCount = 0;
+  bucketBytes = 0;
+  keyBytes = 0;
+  useHugePages = false;
+  shared = false;
+}
+
+StateTable::StateTable(size_t sharedCapacity)
+{
+  size_t newBucketCount = kInitialBucketCount;
+
+  buckets = NULL;
+  keys = NULL;
+  count = 0;
+  bucketBytes = 0;
+  keyBytes = 0;
+  useHugePages = false;
+  shared = true;
+  // the same 3/4 load factor the growing table keeps to
+  while (newBucketCount * kStateTableBucketSlots * 3 < sharedCapacity * 4) {
+    newBucketCount *= 2;
+  }
+  allocate(newBucketCount);
+  maxCount = newBucketCount * kStateTableBucketSlots / 4 * 3;
+}
+
+StateTable::~StateTable()
+{
+  clear();
+}
+
+void StateTable::allocate(size_t newBucketCount)
+{
+  bucketBytes = newBucketCount * sizeof(Bucket);
+  keyBytes = newBucketCount * kStateTableBucketSlots * sizeof(StateKey);
+
+  buckets = static_cast<Bucket*>(allocateTableMemory(&bucketBytes, useHugePages));
+  keys = static_cast<StateKey*>(allocateTableMemory(&keyBytes, useHugePages));
+  bucketCount = newBucketCount;
+  bucketShift = 64;
+  while (newBucketCount > 1) {
+    bucketShift--;
+    newBucketCount >>= 1;
+  }
+}
+
+bool StateTable::insert(const StateKey& key, uint64_t hash)
+{
+  if (shared) {
+    return insertShared(key, hash);
+  }
+  // keep the load factor at or under 3/4
+  if ((count + 1) * 4 > bucketCount * kStateTableBucketSlots * 3) {
+    grow();
+  }
+
+  uint64_t tag = hash | 1;
+  size_t mask = bucketCount - 1;
+  // bucketShift is 64 for a one bucket table, and shifting by 64 is undefined
+  size_t b = bucketShift < 64 ? size_t(hash >> bucketShift) : 0;
+  for (;;) {
+    atomic<uint64_t>* tags = buckets[b].tags;
+    for (int slot = 0; slot < kStateTableBucketSlots; slot++) {
+      uint64_t current = tags[slot].load(memory_order_relaxed);
+      if (current == 0) {
+        tags[slot].store(tag, memory_order_relaxed);
+        keys[b * kStateTableBucketSlots + slot] = key;
+        // only this thread touches an unshared table
+        count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        return true;
+      }
+      if (current == tag && keys[b * kStateTableBucketSlots + slot] == key) {
+        return false;
+      }
+    }
+    b = (b + 1) & mask;
+  }
+}
+
+// Two threads adding the same key race for the same first empty slot, since
+// slots are never emptied; the loser waits for the winner's tag and then
+// finds the key already there.
+bool StateTable::insertShared(const StateKey& key, uint64_t hash)
+{
+  uint64_t tag = hash | 1;
+  size_t mask = bucketCount - 1;
+  size_t b = size_t(hash >> bucketShift);
+  for (;;) {
+    atomic<uint64_t>* tags = buckets[b].tags;
+    for (int slot = 0; slot < kStateTableBucketSlots; slot++) {
+      uint64_t current = tags[slot].load(memory_order_acquire);
+      if (current == 0) {
+        if (count.load(memory_order_relaxed) >= maxCount) {
+          // the key may never have been seen; calling it seen would quietly
+          // cut off the search below it
+          throw std::bad_alloc();
+        }
+        if (tags[slot].compare_exchange_strong(current, kBusyTag, memory_order_acquire)) {
+          keys[b * kStateTableBucketSlots + slot] = key;
+          tags[slot].store(tag, memory_order_release);
+          count.fetch_add(1, memory_order_relaxed);
+          return true;
+        }
+        // another thread got the slot first; current is what it put there
+      }
+      while (current == kBusyTag) {
+        current = tags[slot].load(memory_order_acquire);
+      }
+      if (current == tag && keys[b * kStateTableBucketSlots + slot] == key) {
+        return false;
+      }
+    }
+    b = (b + 1) & mask;
+  }
+}
+
+void StateTable::grow()
+{
+  Bucket* oldBuckets = buckets;
+  StateKey* oldKeys = keys;
+  size_t oldBucketCount = bucketCount;
+  size_t oldBucketBytes = bucketBytes;
+  size_t oldKeyBytes = keyBytes;
+  size_t i;
+  int slot;
+
+  allocate(oldBucketCount == 0 ? size_t(kInitialBucketCount) : oldBucketCount * 2);
+
+  // rehash; every key is known to be unique, so no need to compare them. The
+  // tags keep all but the lowest bit of the hash, which is all we need.
+  size_t mask = bucketCount - 1;
+  for (i = 0; i < oldBucketCount; i++) {
+    for (slot = 0; slot < kStateTableBucketSlots; slot++) {
+      uint64_t tag = oldBuckets[i].tags[slot].load(memory_order_relaxed);
+      if (tag != 0) {
+        size_t b = size_t(tag >> bucketShift);
+        int freeSlot;
+        for (;;) {
+          for (freeSlot = 0; freeSlot < kStateTableBucketSlots; freeSlot++) {
+            if (buckets[b].tags[freeSlot].load(memory_order_relaxed) == 0) {
+              break;
+            }
+          }
+          if (freeSlot < kStateTableBucketSlots) {
+            break;
+          }
+          b = (b + 1) & mask;
+        }
+        buckets[b].tags[freeSlot].store(tag, memory_order_relaxed);
+        keys[b * kStateTableBucketSlots + freeSlot] = oldKeys[i * kStateTableBucketSlots + slot];
+      }
+    }
+  }
+  freeTableMemory(oldBuckets, oldBucketBytes);
+  freeTableMemory(oldKeys, oldKeyBytes);
+}
+
+void StateTable::clear()
+{
+  freeTableMemory(buckets, bucketBytes);
+  freeTableMemory(keys, keyBytes);
+  buckets = NULL;
+  keys = NULL;
+  bucketCount = 0;
+  bucketShift = 64;
+  count = 0;
+  bucketBytes = 0;
+  keyBytes = 0;
+}
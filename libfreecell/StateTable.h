@@ -0,0 +1,116 @@
+// StateTable.h
+// The set of FreeCell positions the solver has already visited.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef STATETABLE_H
+#define STATETABLE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "StateKey.h"
+
+enum {
+  kStateTableBucketSlots = 8
+};
+
+/**
+ * An open addressing transposition table of StateKeys, indexed by the
+ * position hash that FreeCellGame maintains.
+ * The table is an array of buckets, a power of two of them. Each bucket is one
+ * cache line holding the hashes of up to 8 keys; the keys themselves are kept
+ * in a parallel array and are only compared when a hash matches, so a lookup
+ * normally touches a single cache line. A full bucket spills into the next.
+ * A table made with a capacity is shared: it is allocated once and never
+ * grows, and any number of threads may insert at once. A slot is claimed with
+ * a compare and swap, which marks it busy while its key is written.
+ **/
+class StateTable {
+public:
+  StateTable();
+  explicit StateTable(size_t sharedCapacity);
+  ~StateTable();
+
+  // Adds key to the table. Returns true if it was not there before, false if
+  // it had already been added. hash must be the position hash of the key.
+  // Throws std::bad_alloc once a shared table is as full as it should get.
+  bool insert(const StateKey& key, uint64_t hash);
+  // empties the table and frees its memory; not for a shared table that is
+  // in use
+  void clear();
+
+  // Ask for the table memory to be backed by huge pages, where the system
+  // supports it. Takes effect the next time the table grows.
+  void setUseHugePages(bool use);
+
+  size_t size() const;
+  size_t memoryUsage() const;
+  // the memory the positions in the table take up; a shared table sets aside
+  // all it will ever use up front, so this is far less than memoryUsage
+  size_t usedMemory() const;
+
+private:
+  struct alignas(64) Bucket {
+    // 0 means the slot is empty, kBusyTag that a thread is filling it in;
+    // otherwise the hash with its low bit set
+    std::atomic<uint64_t> tags[kStateTableBucketSlots];
+  };
+
+  // not copyable
+  StateTable(const StateTable&);
+  StateTable& operator = (const StateTable&);
+
+  bool insertShared(const StateKey& key, uint64_t hash);
+  void allocate(size_t newBucketCount);
+  void grow();
+
+  Bucket* buckets;
+  StateKey* keys; // kStateTableBucketSlots per bucket
+  size_t bucketCount; // always a power of two
+  unsigned int bucketShift; // bucket index = hash >> bucketShift
+  std::atomic<size_t> count;
+  size_t maxCount; // for a shared table
+  size_t bucketBytes, keyBytes; // as allocated, rounded up for huge pages
+  bool useHugePages;
+  bool shared;
+};
+
+inline size_t StateTable::size() const
+{
+  return count.load(std::memory_order_relaxed);
+}
+
+inline size_t StateTable::memoryUsage() const
+{
+  return bucketBytes + keyBytes;
+}
+
+inline size_t StateTable::usedMemory() const
+{
+  if (!shared) {
+    return memoryUsage();
+  }
+  return size() * (sizeof(StateKey) + sizeof(uint64_t));
+}
+
+inline void StateTable::setUseHugePages(bool use)
+{
+  useHugePages = use;
+}
+
+#endif // STATETABLE_H
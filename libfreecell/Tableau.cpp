@@ -17,22 +17,23 @@
 
 #include "Tableau.h"
 #include <iostream>
+#include <algorithm>
 
 using namespace std;
 
+// Tableaus are compared card by card, from the bottom up, so that two
+// tableaus are equal only if they hold exactly the same cards in the same order.
 bool Tableau::operator < (const Tableau& rhs) const
 {
-    if (size() < rhs.size())
-        return true;
-    else if (size() > rhs.size())
-        return false;
-    if (rhs.empty()) {
-        return false;
-    }
-    return top() < rhs.top();
+    const vector<Card>& lhsCards = *this;
+    const vector<Card>& rhsCards = rhs;
+    return lexicographical_compare(lhsCards.begin(), lhsCards.end(),
+                                   rhsCards.begin(), rhsCards.end());
 }
 
 bool Tableau::operator == (const Tableau& rhs) const
 {
-    return size() == rhs.size() && top() == rhs.top();
+    const vector<Card>& lhsCards = *this;
+    const vector<Card>& rhsCards = rhs;
+    return lhsCards == rhsCards;
 }
\ No newline at end of file
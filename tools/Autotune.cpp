@@ -0,0 +1,352 @@
+// Autotune.cpp
+// Searches for solver parameters that solve a corpus of deals with the
+// fewest positions expanded.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// C++ Includes
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+// C includes
+#include <stdlib.h>
+#include <string.h>
+
+// Project includes
+#include "Solve FreeCell.h"
+#include "Deals.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+enum {
+  kDefaultRounds = 200,
+  kDefaultNodeLimit = 200000
+};
+
+// how a set of parameters did over the corpus
+struct Evaluation {
+  double meanNodes;
+  unsigned long long p99Nodes;
+  unsigned int unsolved;
+  double cost; // what the tuner minimises: meanNodes + p99Nodes
+};
+
+// The parameters the tuner changes, as doubles so small steps add up. Scores
+// are kept on the same footing by stepping each in proportion to its size,
+// with kMinScoreStep for the ones at or near 0.
+struct Candidate {
+  vector<double> scores;
+  double maxMovesBetweenFoundationMoves;
+  double bestFirstWeight;
+};
+
+const double kMinScoreStep = 20;
+const double kInitialStep = 0.5;
+const double kSmallestStep = 0.02;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Prototypes
+static void evaluate(const SolverParameters& parameters, const vector<vector<Tableau> >& deals,
+                     SolveStrategy strategy, unsigned long long nodeLimit,
+                     Evaluation* evaluation);
+static void toCandidate(const SolverParameters& parameters, Candidate* candidate);
+static void toParameters(const Candidate& candidate, SolverParameters* parameters);
+static void mutate(const Candidate& parent, double step, bool bestFirst,
+                   mt19937* random, Candidate* child);
+static void randomCandidate(const Candidate& around, bool bestFirst, mt19937* random,
+                            Candidate* child);
+static size_t firstTunedScore(bool bestFirst);
+static void report(const char* what, unsigned int round, const Evaluation& evaluation);
+static void usage();
+
+// the scores in the order Candidate keeps them. The depth-first search
+// generates foundation moves in a stage of their own, ahead of the rest, so
+// toFoundation only changes the order the best-first search tries moves in;
+// see firstTunedScore.
+static long MoveScores::* const kScores[] = {
+  &MoveScores::toFoundation,
+  &MoveScores::offFreeCell,
+  &MoveScores::toTableau,
+  &MoveScores::fromTableau,
+  &MoveScores::toFreeCell,
+  &MoveScores::toEmptyTableauPerRank,
+  &MoveScores::fromPreferredOrigin,
+  &MoveScores::toPreferredDestination,
+  &MoveScores::penaltyForBuryingCard
+};
+const size_t kScoreCount = sizeof(kScores) / sizeof(kScores[0]);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Implementations
+
+// main
+// autotune [options] DEALS
+// DEALS is a file of deals, one per line, as parseDeal reads them. Options:
+// -b: tune the best-first search instead of the depth-first one
+// -n N: try N candidates (default 200)
+// -l N: give up on a deal after expanding N positions (default 200000); an
+//   unsolved deal counts as twice that
+// -r: random search around the starting point instead of hill climbing
+// -s N: seed the tuner's and the solver's random numbers with N
+// -i FILE: start from the parameters in FILE instead of the defaults
+// -o FILE: write the best parameters found to FILE instead of stdout
+// Each candidate solves every deal with the same solver seed, so the only
+// thing that differs between candidates is the parameters.
+int main(int argc, char** argv) {
+  vector<vector<Tableau> > deals;
+  SolveStrategy strategy = kStrategyDepthFirst;
+  unsigned int rounds = kDefaultRounds, seed = 1, round, badLine = 0;
+  unsigned long long nodeLimit = kDefaultNodeLimit;
+  bool randomSearch = false;
+  const char* outputPath = NULL;
+  SolverParameters parameters = getDefaultSolverParameters(), tried;
+  Candidate best, child;
+  Evaluation bestEvaluation, evaluation;
+  double step = kInitialStep;
+
+  while (argc > 1 && argv[1][0] == '-') {
+    if (strcmp(argv[1], "-b") == 0) {
+      strategy = kStrategyBestFirst;
+    }
+    else if (strcmp(argv[1], "-r") == 0) {
+      randomSearch = true;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+      rounds = (unsigned int)atoi(argv[2]);
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-l") == 0) {
+      nodeLimit = strtoull(argv[2], NULL, 10);
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+      seed = (unsigned int)atoi(argv[2]);
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-i") == 0) {
+      if (!loadSolverParameters(argv[2], &parameters)) {
+        cerr << "Can't read solver parameters from " << argv[2] << endl;
+        return 1;
+      }
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+      outputPath = argv[2];
+      argc--;
+      argv++;
+    }
+    else {
+      usage();
+      return 1;
+    }
+    argc--;
+    argv++;
+  }
+  if (argc != 2) {
+    usage();
+    return 1;
+  }
+  if (!loadDeals(argv[1], &deals, &badLine) || deals.empty()) {
+    if (badLine != 0) {
+      cerr << argv[1] << ":" << badLine << ": not a deal" << endl;
+    }
+    else {
+      cerr << "No deals in " << argv[1] << endl;
+    }
+    return 1;
+  }
+
+  mt19937 random(seed);
+
+  toCandidate(parameters, &best);
+  evaluate(parameters, deals, strategy, nodeLimit, &bestEvaluation);
+  report("start", 0, bestEvaluation);
+  for (round = 1; round <= rounds; round++) {
+    if (randomSearch) {
+      toCandidate(parameters, &child);
+      randomCandidate(child, strategy == kStrategyBestFirst, &random, &child);
+    }
+    else {
+      mutate(best, step, strategy == kStrategyBestFirst, &random, &child);
+    }
+    toParameters(child, &tried);
+    evaluate(tried, deals, strategy, nodeLimit, &evaluation);
+    if (evaluation.cost < bestEvaluation.cost) {
+      best = child;
+      bestEvaluation = evaluation;
+      report("better", round, evaluation);
+      // the one-fifth rule: widen the steps while they keep paying off
+      step *= 1.5;
+    }
+    else {
+      step = max(step * 0.9, kSmallestStep);
+    }
+  }
+
+  toParameters(best, &parameters);
+  if (outputPath != NULL) {
+    ofstream out(outputPath);
+    out << "# " << deals.size() << " deals: mean " << bestEvaluation.meanNodes
+        << " positions, p99 " << bestEvaluation.p99Nodes << ", "
+        << bestEvaluation.unsolved << " unsolved" << endl;
+    writeSolverParameters(out, parameters);
+    if (!out) {
+      cerr << "Can't write " << outputPath << endl;
+      return 1;
+    }
+  }
+  else {
+    writeSolverParameters(cout, parameters);
+  }
+  return 0;
+}
+
+// evaluate
+// Solves every deal with the parameters and sums up the positions expanded.
+// Each deal gets the same seed every time, so only the parameters differ.
+static void evaluate(const SolverParameters& parameters, const vector<vector<Tableau> >& deals,
+                     SolveStrategy strategy, unsigned long long nodeLimit,
+                     Evaluation* evaluation) {
+  Solver solver;
+  vector<unsigned long long> nodes(deals.size());
+  vector<CardMove> solution;
+  SolveStatus status;
+  double total = 0;
+  size_t i;
+
+  solver.setParameters(parameters);
+  solver.setNodeLimit(nodeLimit);
+  // only the searches are being measured
+  solver.setPeepholeWindow(0);
+  evaluation->unsolved = 0;
+  for (i = 0; i < deals.size(); i++) {
+    solver.setRandomSeed((unsigned int)i + 1);
+    status = solver.solve(&solution, deals[i], strategy);
+    nodes[i] = solver.getNodesExpanded();
+    if (status != kSolveSolved) {
+      nodes[i] = 2 * nodeLimit;
+      evaluation->unsolved++;
+    }
+    total += nodes[i];
+  }
+  sort(nodes.begin(), nodes.end());
+  evaluation->meanNodes = total / nodes.size();
+  evaluation->p99Nodes = nodes[(nodes.size() * 99 + 99) / 100 - 1];
+  evaluation->cost = evaluation->meanNodes + evaluation->p99Nodes;
+}
+
+static void toCandidate(const SolverParameters& parameters, Candidate* candidate) {
+  size_t i;
+
+  candidate->scores.resize(kScoreCount);
+  for (i = 0; i < kScoreCount; i++) {
+    candidate->scores[i] = double(parameters.scores.*kScores[i]);
+  }
+  candidate->maxMovesBetweenFoundationMoves = parameters.maxMovesBetweenFoundationMoves;
+  candidate->bestFirstWeight = parameters.bestFirstWeight;
+}
+
+static void toParameters(const Candidate& candidate, SolverParameters* parameters) {
+  size_t i;
+
+  for (i = 0; i < kScoreCount; i++) {
+    parameters->scores.*kScores[i] = lround(candidate.scores[i]);
+  }
+  parameters->maxMovesBetweenFoundationMoves =
+      (unsigned int)max(1L, lround(candidate.maxMovesBetweenFoundationMoves));
+  parameters->bestFirstWeight = (unsigned int)max(0L, lround(candidate.bestFirstWeight));
+}
+
+// mutate
+// Moves each parameter the strategy uses with even odds by a normally
+// distributed step, step times its size across. At least one always moves.
+static void mutate(const Candidate& parent, double step, bool bestFirst,
+                   mt19937* random, Candidate* child) {
+  normal_distribution<double> normal(0, step);
+  bernoulli_distribution coin(0.5);
+  size_t i, forced;
+  size_t first = firstTunedScore(bestFirst);
+  size_t count = kScoreCount + (bestFirst ? 2 : 1);
+
+  *child = parent;
+  forced = uniform_int_distribution<size_t>(first, count - 1)(*random);
+  for (i = first; i < count; i++) {
+    if (i != forced && !coin(*random)) {
+      continue;
+    }
+    if (i < kScoreCount) {
+      child->scores[i] += normal(*random) * max(fabs(parent.scores[i]), kMinScoreStep);
+    }
+    else if (i == kScoreCount) {
+      child->maxMovesBetweenFoundationMoves += normal(*random) * parent.maxMovesBetweenFoundationMoves;
+      child->maxMovesBetweenFoundationMoves = max(1.0, child->maxMovesBetweenFoundationMoves);
+    }
+    else {
+      child->bestFirstWeight += normal(*random) * max(parent.bestFirstWeight, 1.0);
+      child->bestFirstWeight = max(0.0, child->bestFirstWeight);
+    }
+  }
+}
+
+// randomCandidate
+// Draws every parameter the strategy uses afresh, anywhere from 0 to twice
+// its starting value.
+static void randomCandidate(const Candidate& around, bool bestFirst, mt19937* random,
+                            Candidate* child) {
+  uniform_real_distribution<double> scale(0, 2);
+  size_t i;
+
+  *child = around;
+  for (i = firstTunedScore(bestFirst); i < kScoreCount; i++) {
+    child->scores[i] = scale(*random) * max(fabs(around.scores[i]), kMinScoreStep);
+  }
+  child->maxMovesBetweenFoundationMoves =
+      max(1.0, scale(*random) * around.maxMovesBetweenFoundationMoves);
+  if (bestFirst) {
+    child->bestFirstWeight = scale(*random) * max(around.bestFirstWeight, 1.0);
+  }
+}
+
+// the first of kScores the strategy's move order depends on
+static size_t firstTunedScore(bool bestFirst) {
+  return bestFirst ? 0 : 1;
+}
+
+static void report(const char* what, unsigned int round, const Evaluation& evaluation) {
+  cerr << "round " << round << " " << what << ": mean " << evaluation.meanNodes
+       << " positions, p99 " << evaluation.p99Nodes << ", "
+       << evaluation.unsolved << " unsolved" << endl;
+}
+
+static void usage() {
+  cerr << "usage: autotune [-b] [-r] [-n rounds] [-l node limit] [-s seed]"
+       << " [-i parameters] [-o parameters] deals" << endl;
+}
@@ -0,0 +1,529 @@
+// Benchmark.cpp
+// Solves a fixed set of Microsoft deals with a fixed seed, records how it
+// went as a JSON baseline, and compares a run against an earlier baseline.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// C++ Includes
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+
+// C includes
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Project includes
+#include "Solve FreeCell.h"
+#include "Deals.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+enum {
+  kDefaultFirstDeal = 1,
+  kDefaultLastDeal = 32000,
+  kDefaultDealStep = 320,
+  kDefaultNodeLimit = 1000000,
+  kDefaultThreshold = 10, // percent
+  // long enough that the peephole optimizer always finishes, so solution
+  // lengths don't depend on how busy the machine is
+  kBenchmarkPeepholeTimeLimit = 60000
+};
+
+// what the benchmark records for one deal
+struct DealRecord {
+  unsigned long deal;
+  bool solved;
+  string status; // as getSolveStatusName gives it
+  size_t moves;
+  unsigned long long nodes;
+  double milliseconds;
+  size_t tableMemory;
+};
+
+// the sums over a run; tableMemory is the largest of any deal
+struct Totals {
+  size_t deals, solved, moves;
+  unsigned long long nodes;
+  double milliseconds;
+  size_t tableMemory;
+  long maxResidentKB;
+};
+
+// what a run was asked to do, so that runs can be checked for being alike
+struct RunSettings {
+  unsigned long firstDeal, lastDeal, dealStep;
+  unsigned int seed;
+  unsigned long long nodeLimit;
+  bool bestFirst;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Prototypes
+static void runBenchmark(const RunSettings& settings, const SolverParameters& parameters,
+                         vector<DealRecord>* records);
+static void sumRecords(const vector<DealRecord>& records, Totals* totals);
+static bool writeBaseline(const char* path, const RunSettings& settings,
+                          const vector<DealRecord>& records, const Totals& totals);
+static bool readBaseline(const char* path, RunSettings* settings,
+                         vector<DealRecord>* records, Totals* totals);
+static bool findNumber(const string& line, const char* key, double* value);
+static bool findString(const string& line, const char* key, string* value);
+static bool compareRuns(const Totals& baseline, const Totals& run,
+                        const vector<DealRecord>& baselineRecords,
+                        const vector<DealRecord>& runRecords, double threshold,
+                        double timeThreshold);
+static bool compareTotal(const char* what, double baseline, double run, double threshold);
+static long getMaxResidentKB();
+static void usage();
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Implementations
+
+// main
+// benchmark [options]
+// -d FIRST-LAST: the range of deal numbers (default 1-32000)
+// -e N: solve every Nth deal of the range, starting with the first (default
+//   320, so 100 deals)
+// -b: use the best-first search instead of the depth-first one
+// -s N: seed the solver with N plus the deal number (default 1)
+// -l N: give up on a deal after expanding N positions (default 1000000)
+// -c FILE: use the solver parameters in FILE, as the autotune tool writes
+// -o FILE: write the run out as a baseline
+// -r FILE: compare the run against the baseline in FILE, with the same deals
+//   and seed as it, and fail if it did worse
+// -x PERCENT: how much worse counts as a regression (default 10)
+// -X PERCENT: how much slower counts as a regression. The times vary from
+//   run to run with how busy the machine is, so by default they are only
+//   reported.
+int main(int argc, char** argv) {
+  RunSettings settings, baselineSettings;
+  SolverParameters parameters = getDefaultSolverParameters();
+  const char* outputPath = NULL;
+  const char* baselinePath = NULL;
+  double threshold = kDefaultThreshold;
+  double timeThreshold = 0;
+  vector<DealRecord> records, baselineRecords;
+  Totals totals, baselineTotals;
+
+  settings.firstDeal = kDefaultFirstDeal;
+  settings.lastDeal = kDefaultLastDeal;
+  settings.dealStep = kDefaultDealStep;
+  settings.seed = 1;
+  settings.nodeLimit = kDefaultNodeLimit;
+  settings.bestFirst = false;
+
+  while (argc > 1 && argv[1][0] == '-') {
+    if (strcmp(argv[1], "-b") == 0) {
+      settings.bestFirst = true;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-d") == 0) {
+      char* end;
+      settings.firstDeal = strtoul(argv[2], &end, 10);
+      settings.lastDeal = (*end == '-') ? strtoul(end + 1, NULL, 10) : settings.firstDeal;
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-e") == 0) {
+      settings.dealStep = max(1UL, strtoul(argv[2], NULL, 10));
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+      settings.seed = (unsigned int)atoi(argv[2]);
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-l") == 0) {
+      settings.nodeLimit = strtoull(argv[2], NULL, 10);
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-c") == 0) {
+      if (!loadSolverParameters(argv[2], &parameters)) {
+        cerr << "Can't read solver parameters from " << argv[2] << endl;
+        return 1;
+      }
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+      outputPath = argv[2];
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+      baselinePath = argv[2];
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-x") == 0) {
+      threshold = atof(argv[2]);
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-X") == 0) {
+      timeThreshold = atof(argv[2]);
+      argc--;
+      argv++;
+    }
+    else {
+      usage();
+      return 1;
+    }
+    argc--;
+    argv++;
+  }
+  if (argc != 1 || settings.firstDeal == 0 || settings.lastDeal < settings.firstDeal ||
+      settings.lastDeal > kLastDealNumber) {
+    usage();
+    return 1;
+  }
+
+  // a comparison runs what the baseline ran
+  if (baselinePath != NULL) {
+    if (!readBaseline(baselinePath, &baselineSettings, &baselineRecords, &baselineTotals)) {
+      cerr << "Can't read a baseline from " << baselinePath << endl;
+      return 1;
+    }
+    settings = baselineSettings;
+  }
+
+  runBenchmark(settings, parameters, &records);
+  sumRecords(records, &totals);
+  cout << fixed << setprecision(1);
+  cout << totals.solved << " of " << totals.deals << " deals solved, "
+       << totals.moves << " moves, " << totals.nodes << " positions, "
+       << totals.milliseconds << " ms, largest tables " << totals.tableMemory
+       << " bytes, peak RSS " << totals.maxResidentKB << " KB" << defaultfloat << endl;
+
+  if (outputPath != NULL && !writeBaseline(outputPath, settings, records, totals)) {
+    cerr << "Can't write " << outputPath << endl;
+    return 1;
+  }
+  if (baselinePath != NULL &&
+      !compareRuns(baselineTotals, totals, baselineRecords, records, threshold,
+                   timeThreshold)) {
+    return 1;
+  }
+  return 0;
+}
+
+// runBenchmark
+// Solves the deals one after another on one thread, so the times are as
+// comparable as the machine allows.
+static void runBenchmark(const RunSettings& settings, const SolverParameters& parameters,
+                         vector<DealRecord>* records) {
+  Solver solver;
+  vector<Tableau> tableaus;
+  vector<CardMove> solution;
+  DealRecord record;
+  chrono::steady_clock::time_point start;
+  SolveStatus status;
+  unsigned long deal;
+
+  solver.setParameters(parameters);
+  solver.setNodeLimit(settings.nodeLimit);
+  solver.setPeepholeTimeLimit(kBenchmarkPeepholeTimeLimit);
+  for (deal = settings.firstDeal; deal <= settings.lastDeal; deal += settings.dealStep) {
+    getMicrosoftDeal(deal, &tableaus);
+    solver.setRandomSeed(settings.seed + (unsigned int)deal);
+    start = chrono::steady_clock::now();
+    status = solver.solve(&solution, tableaus,
+                          settings.bestFirst ? kStrategyBestFirst : kStrategyDepthFirst);
+    record.milliseconds =
+      chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    record.deal = deal;
+    record.solved = (status == kSolveSolved);
+    record.status = getSolveStatusName(status);
+    record.moves = solution.size();
+    record.nodes = solver.getNodesExpanded();
+    record.tableMemory = solver.getTableMemory();
+    records->push_back(record);
+  }
+}
+
+static void sumRecords(const vector<DealRecord>& records, Totals* totals) {
+  size_t i;
+
+  memset(totals, 0, sizeof(*totals));
+  for (i = 0; i < records.size(); i++) {
+    const DealRecord& record = records[i];
+    totals->deals++;
+    if (record.solved) {
+      totals->solved++;
+    }
+    totals->moves += record.moves;
+    totals->nodes += record.nodes;
+    totals->milliseconds += record.milliseconds;
+    totals->tableMemory = max(totals->tableMemory, record.tableMemory);
+  }
+  totals->maxResidentKB = getMaxResidentKB();
+}
+
+// writeBaseline
+// Writes one object per line, so that readBaseline can read it back without
+// a JSON parser.
+static bool writeBaseline(const char* path, const RunSettings& settings,
+                          const vector<DealRecord>& records, const Totals& totals) {
+  ofstream out(path);
+  size_t i;
+
+  out << fixed << setprecision(3);
+  out << "{\n";
+  out << "  \"settings\": {\"first\": " << settings.firstDeal
+      << ", \"last\": " << settings.lastDeal
+      << ", \"step\": " << settings.dealStep
+      << ", \"seed\": " << settings.seed
+      << ", \"node_limit\": " << settings.nodeLimit
+      << ", \"best_first\": " << (settings.bestFirst ? 1 : 0) << "},\n";
+  out << "  \"totals\": {\"deals\": " << totals.deals
+      << ", \"solved\": " << totals.solved
+      << ", \"moves\": " << totals.moves
+      << ", \"nodes\": " << totals.nodes
+      << ", \"ms\": " << totals.milliseconds
+      << ", \"peak_table_bytes\": " << totals.tableMemory
+      << ", \"max_rss_kb\": " << totals.maxResidentKB << "},\n";
+  out << "  \"deals\": [\n";
+  for (i = 0; i < records.size(); i++) {
+    const DealRecord& record = records[i];
+    out << "    {\"deal\": " << record.deal
+        << ", \"solved\": " << (record.solved ? 1 : 0)
+        << ", \"status\": \"" << record.status << "\""
+        << ", \"moves\": " << record.moves
+        << ", \"nodes\": " << record.nodes
+        << ", \"ms\": " << record.milliseconds
+        << ", \"peak_table_bytes\": " << record.tableMemory << "}"
+        << (i + 1 < records.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+  return bool(out);
+}
+
+// readBaseline
+// Reads back what writeBaseline wrote.
+static bool readBaseline(const char* path, RunSettings* settings,
+                         vector<DealRecord>* records, Totals* totals) {
+  ifstream in(path);
+  string line;
+  double value;
+  DealRecord record;
+  bool haveSettings = false, haveTotals = false;
+
+  if (!in) {
+    return false;
+  }
+  memset(totals, 0, sizeof(*totals));
+  while (getline(in, line)) {
+    if (line.find("\"settings\"") != string::npos) {
+      haveSettings = findNumber(line, "first", &value);
+      settings->firstDeal = (unsigned long)value;
+      haveSettings = haveSettings && findNumber(line, "last", &value);
+      settings->lastDeal = (unsigned long)value;
+      haveSettings = haveSettings && findNumber(line, "step", &value);
+      settings->dealStep = (unsigned long)value;
+      haveSettings = haveSettings && findNumber(line, "seed", &value);
+      settings->seed = (unsigned int)value;
+      haveSettings = haveSettings && findNumber(line, "node_limit", &value);
+      settings->nodeLimit = (unsigned long long)value;
+      haveSettings = haveSettings && findNumber(line, "best_first", &value);
+      settings->bestFirst = value != 0;
+    }
+    else if (line.find("\"totals\"") != string::npos) {
+      haveTotals = findNumber(line, "deals", &value);
+      totals->deals = (size_t)value;
+      haveTotals = haveTotals && findNumber(line, "solved", &value);
+      totals->solved = (size_t)value;
+      haveTotals = haveTotals && findNumber(line, "moves", &value);
+      totals->moves = (size_t)value;
+      haveTotals = haveTotals && findNumber(line, "nodes", &value);
+      totals->nodes = (unsigned long long)value;
+      haveTotals = haveTotals && findNumber(line, "ms", &value);
+      totals->milliseconds = value;
+      haveTotals = haveTotals && findNumber(line, "peak_table_bytes", &value);
+      totals->tableMemory = (size_t)value;
+      haveTotals = haveTotals && findNumber(line, "max_rss_kb", &value);
+      totals->maxResidentKB = (long)value;
+    }
+    else if (findNumber(line, "deal", &value)) {
+      record.deal = (unsigned long)value;
+      if (!findNumber(line, "solved", &value)) {
+        return false;
+      }
+      record.solved = value != 0;
+      // baselines written before statuses were recorded have none
+      if (!findString(line, "status", &record.status)) {
+        record.status.clear();
+      }
+      if (!findNumber(line, "moves", &value)) {
+        return false;
+      }
+      record.moves = (size_t)value;
+      if (!findNumber(line, "nodes", &value)) {
+        return false;
+      }
+      record.nodes = (unsigned long long)value;
+      if (!findNumber(line, "ms", &value)) {
+        return false;
+      }
+      record.milliseconds = value;
+      if (!findNumber(line, "peak_table_bytes", &value)) {
+        return false;
+      }
+      record.tableMemory = (size_t)value;
+      records->push_back(record);
+    }
+  }
+  return haveSettings && haveTotals;
+}
+
+// findNumber
+// Finds "key": in the line and reads the number after it.
+static bool findNumber(const string& line, const char* key, double* value) {
+  string quoted = string("\"") + key + "\":";
+  size_t at = line.find(quoted);
+  const char* start;
+  char* end;
+
+  if (at == string::npos) {
+    return false;
+  }
+  start = line.c_str() + at + quoted.size();
+  *value = strtod(start, &end);
+  return end != start;
+}
+
+// findString
+// Finds "key": in the line and reads the quoted string after it.
+static bool findString(const string& line, const char* key, string* value) {
+  string quoted = string("\"") + key + "\": \"";
+  size_t at = line.find(quoted), end;
+
+  if (at == string::npos) {
+    return false;
+  }
+  at += quoted.size();
+  end = line.find('"', at);
+  if (end == string::npos) {
+    return false;
+  }
+  *value = line.substr(at, end - at);
+  return true;
+}
+
+// compareRuns
+// Reports how the run did against the baseline, and returns false if it
+// solved fewer deals or any of its counts grew by more than threshold
+// percent. The counts come out the same every time the same code runs;
+// the time only fails the run if timeThreshold is set, and by more than
+// that. The deals whose positions grew the most are listed, to start
+// looking from, and so are the deals that stopped for another reason than
+// before.
+static bool compareRuns(const Totals& baseline, const Totals& run,
+                        const vector<DealRecord>& baselineRecords,
+                        const vector<DealRecord>& runRecords, double threshold,
+                        double timeThreshold) {
+  vector<pair<double, unsigned long> > growth;
+  bool passed = true;
+  size_t i;
+
+  if (baselineRecords.size() != runRecords.size()) {
+    cerr << "The baseline has " << baselineRecords.size() << " deals, the run "
+         << runRecords.size() << endl;
+    return false;
+  }
+  if (run.solved < baseline.solved) {
+    cout << "REGRESSION solved: " << baseline.solved << " -> " << run.solved << endl;
+    passed = false;
+  }
+  passed = compareTotal("nodes", baseline.nodes, run.nodes, threshold) && passed;
+  passed = compareTotal("moves", baseline.moves, run.moves, threshold) && passed;
+  passed = compareTotal("ms", baseline.milliseconds, run.milliseconds,
+                        timeThreshold > 0 ? timeThreshold
+                                          : numeric_limits<double>::infinity()) && passed;
+  passed = compareTotal("peak_table_bytes", baseline.tableMemory, run.tableMemory,
+                        threshold) && passed;
+
+  for (i = 0; i < runRecords.size(); i++) {
+    double before = double(baselineRecords[i].nodes), after = double(runRecords[i].nodes);
+    if (after > before) {
+      growth.push_back(make_pair((after - before) / max(before, 1.0), runRecords[i].deal));
+    }
+  }
+  sort(growth.rbegin(), growth.rend());
+  for (i = 0; i < growth.size() && i < 5; i++) {
+    cout << "  deal " << growth[i].second << ": positions up " << fixed
+         << setprecision(1) << growth[i].first * 100 << "%" << defaultfloat << endl;
+  }
+  for (i = 0; i < runRecords.size(); i++) {
+    const string& before = baselineRecords[i].status;
+    if (!before.empty() && before != runRecords[i].status) {
+      cout << "  deal " << runRecords[i].deal << ": " << before << " -> "
+           << runRecords[i].status << endl;
+    }
+  }
+  cout << (passed ? "No regressions" : "Regressions found") << " beyond "
+       << setprecision(6) << threshold << "%" << endl;
+  return passed;
+}
+
+static bool compareTotal(const char* what, double baseline, double run, double threshold) {
+  double change = (baseline > 0) ? (run - baseline) / baseline * 100 : 0;
+  bool regressed = change > threshold;
+
+  cout << (regressed ? "REGRESSION " : "") << what << ": " << defaultfloat
+       << setprecision(12) << baseline << " -> " << run << " (" << fixed << setprecision(1)
+       << showpos << change << noshowpos << "%)" << defaultfloat << endl;
+  return !regressed;
+}
+
+// getMaxResidentKB
+// the most memory the process has held at once, where the system says
+static long getMaxResidentKB() {
+#ifndef _WIN32
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes there
+#else
+    return usage.ru_maxrss;
+#endif
+  }
+#endif
+  return 0;
+}
+
+static void usage() {
+  cerr << "usage: benchmark [-d first-last] [-e step] [-b] [-s seed] [-l node limit]"
+       << " [-c parameters] [-o baseline] [-r baseline] [-x percent]"
+       << " [-X percent]" << endl;
+}
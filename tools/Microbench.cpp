@@ -0,0 +1,468 @@
+// Microbench.cpp
+// Times the solver's hot primitives one at a time, in nanoseconds and heap
+// allocations per call, so a slower deal can be traced to the piece that
+// got slower.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// C++ Includes
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <random>
+#include <new>
+
+// C includes
+#include <stdlib.h>
+#include <string.h>
+
+// Project includes
+#include "Solve FreeCell.h"
+#include "FreeCellGame.h"
+#include "StateTable.h"
+#include "Deals.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+enum {
+  kDefaultDeals = 20,
+  kDefaultMinimumTime = 200, // milliseconds per benchmark
+  // how far a random walk goes from its deal before starting again
+  kWalkLength = 150
+};
+
+// the table sizes the state table benchmarks fill up to before timing
+const size_t kTableSizes[] = {1 << 10, 1 << 16, 1 << 20};
+const size_t kTableSizeCount = sizeof(kTableSizes) / sizeof(kTableSizes[0]);
+
+// how many lookups the seen state table benchmarks make per pass
+const size_t kTableProbes = 1 << 14;
+
+// A position partway through a solution: the deal and the moves from it.
+struct Position {
+  vector<Tableau> tableaus;
+  vector<CardMove> moves;
+};
+
+// a position's state key and hash, as a state table is given them
+struct KeyedPosition {
+  StateKey key;
+  uint64_t hash;
+};
+
+// One benchmark: a pass over its inputs that returns how many calls it made.
+struct Benchmark {
+  string name;
+  size_t (*pass)(size_t argument);
+  size_t argument;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Globals
+
+// every allocation the program makes goes through operator new below
+static unsigned long long allocationCount = 0;
+
+// the inputs the passes work on, set up before any timing starts. A
+// solution is a Position whose moves end with the game won.
+static vector<vector<Tableau> > deals;
+static vector<Position> rawSolutions; // straight from the search
+static vector<Position> solutions; // as the solver hands them back
+static vector<Position> positions;
+static vector<FreeCellGame*> positionGames;
+static vector<vector<CardMove> > positionMoves; // the legal moves of each
+static vector<KeyedPosition> keyedPositions;
+static vector<StateTable*> filledTables; // one per kTableSizes entry
+
+// the search the passes generate moves with, for the default solver
+static SearchContext context;
+
+// keeps the optimizer from dropping work whose result is never used
+static volatile size_t sink;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Prototypes
+static void setUp(unsigned int dealCount);
+static void collectKeyedPositions(size_t count);
+static void runBenchmark(const Benchmark& benchmark, double minimumTime);
+static size_t passPerformUndo(size_t);
+static size_t passGetPossibleMoves(size_t);
+static size_t passInsertUnseen(size_t tableIndex);
+static size_t passInsertSeen(size_t tableIndex);
+static size_t passCanPlaceOnTop(size_t);
+static size_t passOptimizeMoves(size_t);
+static size_t passValidateSolution(size_t);
+static void usage();
+
+void* operator new(size_t size)
+{
+  void* block;
+
+  allocationCount++;
+  block = malloc(size != 0 ? size : 1);
+  if (block == NULL) {
+    throw bad_alloc();
+  }
+  return block;
+}
+
+void operator delete(void* block) noexcept
+{
+  free(block);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Implementations
+
+// main
+// microbench [options]
+// -d N: take solutions and positions from Microsoft deals 1 to N (default 20)
+// -t MS: run each benchmark for at least MS milliseconds (default 200)
+// -f TEXT: only run the benchmarks whose names contain TEXT
+int main(int argc, char** argv) {
+  unsigned int dealCount = kDefaultDeals;
+  double minimumTime = kDefaultMinimumTime;
+  const char* filter = NULL;
+  vector<Benchmark> benchmarks;
+  size_t i;
+
+  while (argc > 1 && argv[1][0] == '-') {
+    if (argc > 2 && strcmp(argv[1], "-d") == 0) {
+      dealCount = (unsigned int)max(1, atoi(argv[2]));
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+      minimumTime = atof(argv[2]);
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+      filter = argv[2];
+      argc--;
+      argv++;
+    }
+    else {
+      usage();
+      return 1;
+    }
+    argc--;
+    argv++;
+  }
+  if (argc != 1) {
+    usage();
+    return 1;
+  }
+
+  setUp(dealCount);
+
+  benchmarks.push_back(Benchmark());
+  benchmarks.back().name = "performMove+undoMove";
+  benchmarks.back().pass = passPerformUndo;
+  benchmarks.push_back(Benchmark());
+  benchmarks.back().name = "getPossibleMoves";
+  benchmarks.back().pass = passGetPossibleMoves;
+  for (i = 0; i < kTableSizeCount; i++) {
+    benchmarks.push_back(Benchmark());
+    benchmarks.back().name = "StateTable::insert new, to " + to_string(kTableSizes[i]);
+    benchmarks.back().pass = passInsertUnseen;
+    benchmarks.back().argument = i;
+    benchmarks.push_back(Benchmark());
+    benchmarks.back().name = "StateTable::insert seen, at " + to_string(kTableSizes[i]);
+    benchmarks.back().pass = passInsertSeen;
+    benchmarks.back().argument = i;
+  }
+  benchmarks.push_back(Benchmark());
+  benchmarks.back().name = "canPlaceOnTop";
+  benchmarks.back().pass = passCanPlaceOnTop;
+  benchmarks.push_back(Benchmark());
+  benchmarks.back().name = "optimizeMoves";
+  benchmarks.back().pass = passOptimizeMoves;
+  benchmarks.push_back(Benchmark());
+  benchmarks.back().name = "validateSolution";
+  benchmarks.back().pass = passValidateSolution;
+
+  cout << left << setw(36) << "benchmark" << right << setw(12) << "calls"
+       << setw(14) << "ns/call" << setw(14) << "allocs/call" << endl;
+  for (i = 0; i < benchmarks.size(); i++) {
+    if (filter == NULL || benchmarks[i].name.find(filter) != string::npos) {
+      runBenchmark(benchmarks[i], minimumTime);
+    }
+  }
+  return 0;
+}
+
+// setUp
+// Solves the deals, once as the search finds the solution and once as the
+// solver hands it back (without the peephole pass, which would make setting
+// up slow), and takes positions a quarter, half and three quarters of the way
+// through each, along with their legal moves. The state tables are filled
+// from random walks.
+static void setUp(unsigned int dealCount) {
+  Solver solver;
+  PortfolioSearch search;
+  vector<CardMove> solution;
+  MoveBuffer moves;
+  unsigned int deal, i, j;
+
+  search.strategy = kStrategyDepthFirst;
+  search.parameters = getDefaultSolverParameters();
+  solver.setPeepholeWindow(0);
+  for (deal = 1; deal <= dealCount; deal++) {
+    deals.push_back(vector<Tableau>());
+    getMicrosoftDeal(deal, &deals.back());
+
+    search.seed = deal;
+    if (context.runSearch(&solution, deals.back(), search)) {
+      expandSupermoves(&solution, deals.back());
+      rawSolutions.push_back(Position());
+      rawSolutions.back().tableaus = deals.back();
+      rawSolutions.back().moves = solution;
+    }
+    solver.setRandomSeed(deal);
+    solver.solve(&solution, deals.back());
+    if (solution.empty()) {
+      continue;
+    }
+    solutions.push_back(Position());
+    solutions.back().tableaus = deals.back();
+    solutions.back().moves = solution;
+    for (i = 1; i <= 3; i++) {
+      Position position;
+      position.tableaus = deals.back();
+      position.moves.assign(solution.begin(), solution.begin() + solution.size() * i / 4);
+      positions.push_back(position);
+    }
+  }
+
+  for (i = 0; i < positions.size(); i++) {
+    FreeCellGame* game = new FreeCellGame();
+    vector<CardMove> autoMoves;
+
+    context.setSearchPosition(positions[i].tableaus, positions[i].moves);
+    context.getPossibleMoves(&moves);
+    positionMoves.push_back(vector<CardMove>());
+    for (j = 0; j < moves.size(); j++) {
+      positionMoves.back().push_back(moves[j].toCardMove());
+    }
+    // the same position in a game of its own, for performMove to work on
+    game->setTableaus(positions[i].tableaus);
+    for (j = 0; j < positions[i].moves.size(); j++) {
+      game->performMove(positions[i].moves[j]);
+    }
+    game->setAutoPlayRule(kAutoPlaySafe);
+    game->playAutoMoves(&autoMoves);
+    positionGames.push_back(game);
+  }
+
+  collectKeyedPositions(kTableSizes[kTableSizeCount - 1]);
+  for (i = 0; i < kTableSizeCount; i++) {
+    StateTable* table = new StateTable();
+    for (j = 0; j < kTableSizes[i]; j++) {
+      table->insert(keyedPositions[j].key, keyedPositions[j].hash);
+    }
+    filledTables.push_back(table);
+  }
+}
+
+// collectKeyedPositions
+// Walks at random from the deals until it has seen count different
+// positions. The search's own game picks the moves; a game kept in step with
+// it gives up the keys. That game keeps one column store for all the deals,
+// so keys from different deals never clash.
+static void collectKeyedPositions(size_t count) {
+  FreeCellGame walker;
+  ColumnStore columns;
+  StateTable seen;
+  MoveBuffer moves;
+  vector<CardMove> played, autoMoves;
+  minstd_rand random(1);
+  KeyedPosition position;
+  size_t deal = 0, step;
+
+  walker.setColumnStore(&columns);
+  walker.setAutoPlayRule(kAutoPlaySafe);
+  while (keyedPositions.size() < count) {
+    const vector<Tableau>& tableaus = deals[deal++ % deals.size()];
+    context.setSearchPosition(tableaus, vector<CardMove>());
+    walker.reset();
+    walker.setTableaus(tableaus);
+    walker.playAutoMoves(&autoMoves);
+    played.clear();
+    for (step = 0; step < kWalkLength && keyedPositions.size() < count; step++) {
+      context.getPossibleMoves(&moves);
+      if (moves.empty()) {
+        break;
+      }
+      CardMove move = moves[random() % moves.size()].toCardMove();
+      context.makeMove(&played, move);
+      walker.performMove(move);
+      walker.playAutoMoves(&autoMoves);
+      walker.getStateKey(&position.key);
+      position.hash = walker.getPositionHash();
+      if (seen.insert(position.key, position.hash)) {
+        keyedPositions.push_back(position);
+      }
+    }
+  }
+}
+
+// runBenchmark
+// Repeats the benchmark's pass until minimumTime has gone by, and reports
+// the time and allocations per call.
+static void runBenchmark(const Benchmark& benchmark, double minimumTime) {
+  chrono::steady_clock::time_point start;
+  double elapsed = 0;
+  size_t calls = 0;
+  unsigned long long allocations;
+
+  // once untimed, so that buffers the pass grows are already grown
+  benchmark.pass(benchmark.argument);
+  allocations = allocationCount;
+  start = chrono::steady_clock::now();
+  while (elapsed < minimumTime) {
+    calls += benchmark.pass(benchmark.argument);
+    elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  }
+  allocations = allocationCount - allocations;
+
+  cout << left << setw(36) << benchmark.name << right << setw(12) << calls
+       << fixed << setprecision(1) << setw(14) << elapsed * 1e6 / calls
+       << setprecision(2) << setw(14) << double(allocations) / calls << endl;
+}
+
+// passPerformUndo
+// Plays and takes back every legal move from every saved position.
+static size_t passPerformUndo(size_t) {
+  size_t i, j, calls = 0;
+
+  for (i = 0; i < positionGames.size(); i++) {
+    FreeCellGame& game = *positionGames[i];
+    const vector<CardMove>& moves = positionMoves[i];
+    for (j = 0; j < moves.size(); j++) {
+      game.performMove(moves[j]);
+      game.undoMove(moves[j]);
+    }
+    calls += moves.size();
+  }
+  return calls;
+}
+
+// passGetPossibleMoves
+// Generates the moves from each saved position a hundred times. Putting the
+// search at the position isn't a call, but its time and allocations are
+// spread over the hundred.
+static size_t passGetPossibleMoves(size_t) {
+  MoveBuffer moves;
+  size_t i, j, total = 0;
+
+  for (i = 0; i < positions.size(); i++) {
+    context.setSearchPosition(positions[i].tableaus, positions[i].moves);
+    for (j = 0; j < 100; j++) {
+      context.getPossibleMoves(&moves);
+      total += moves.size();
+    }
+  }
+  sink = total;
+  return positions.size() * 100;
+}
+
+// passInsertUnseen
+// Fills an empty table up to the size, as a search does, growing it on the
+// way.
+static size_t passInsertUnseen(size_t tableIndex) {
+  StateTable table;
+  size_t i, size = kTableSizes[tableIndex];
+
+  for (i = 0; i < size; i++) {
+    table.insert(keyedPositions[i].key, keyedPositions[i].hash);
+  }
+  return size;
+}
+
+// passInsertSeen
+// Looks up positions the table already holds, spread over all of it.
+static size_t passInsertSeen(size_t tableIndex) {
+  StateTable& table = *filledTables[tableIndex];
+  size_t i, size = kTableSizes[tableIndex], stride = size / kTableProbes + 1;
+  size_t found = 0;
+
+  for (i = 0; i < kTableProbes; i++) {
+    const KeyedPosition& position = keyedPositions[(i * stride) % size];
+    found += !table.insert(position.key, position.hash);
+  }
+  sink = found;
+  return kTableProbes;
+}
+
+// passCanPlaceOnTop
+// Every card against every other.
+static size_t passCanPlaceOnTop(size_t) {
+  const CardSuit suits[] = {clubs, diamonds, hearts, spades};
+  Card cards[NUM_CARDS];
+  size_t i, j, fits = 0;
+
+  for (i = 0; i < NUM_CARDS; i++) {
+    cards[i].num = (unsigned short)(i / NUM_SUITS + 1);
+    cards[i].suit = suits[i % NUM_SUITS];
+  }
+  for (i = 0; i < NUM_CARDS; i++) {
+    for (j = 0; j < NUM_CARDS; j++) {
+      fits += canPlaceOnTop(cards[i], cards[j]);
+    }
+  }
+  sink = fits;
+  return NUM_CARDS * NUM_CARDS;
+}
+
+// passOptimizeMoves
+// Optimizes copies of the solutions the search found before the solver
+// shortened them.
+static size_t passOptimizeMoves(size_t) {
+  vector<CardMove> solution;
+  size_t i;
+
+  for (i = 0; i < rawSolutions.size(); i++) {
+    solution = rawSolutions[i].moves;
+    optimizeMoves(&solution, rawSolutions[i].tableaus);
+  }
+  return rawSolutions.size();
+}
+
+// passValidateSolution
+static size_t passValidateSolution(size_t) {
+  size_t i, valid = 0;
+
+  for (i = 0; i < solutions.size(); i++) {
+    valid += validateSolution(solutions[i].moves, solutions[i].tableaus);
+  }
+  sink = valid;
+  return solutions.size();
+}
+
+static void usage() {
+  cerr << "usage: microbench [-d deals] [-t milliseconds] [-f filter]" << endl;
+}
@@ -0,0 +1,270 @@
+// Perft.cpp
+// Counts every position the move generator reaches to a given depth, with no
+// pruning, the way chess programs check theirs: the counts catch a generator
+// that gains or loses moves, and the rate shows how fast it runs.
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// C++ Includes
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+
+// C includes
+#include <stdlib.h>
+#include <string.h>
+
+// Project includes
+#include "Solve FreeCell.h"
+#include "Deals.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+enum {
+  kDefaultDepth = 4
+};
+
+// A leaf count the generator is known to give, with supermoves and the safe
+// auto play rule, as the solver uses by default. A change to what moves the
+// generator offers will change these; one that only makes it faster must
+// not.
+struct KnownCount {
+  unsigned long deal;
+  unsigned int depth;
+  unsigned long long leaves;
+};
+
+const KnownCount kKnownCounts[] = {
+  {1, 1, 8},
+  {1, 4, 6620},
+  {1, 7, 1359773},
+  {617, 6, 833705},
+  {11982, 6, 714228},
+  {31465, 6, 302810}
+};
+const size_t kKnownCountCount = sizeof(kKnownCounts) / sizeof(kKnownCounts[0]);
+
+// how much a count took
+struct PerftCount {
+  unsigned long long leaves;
+  unsigned long long nodes; // every position visited, leaves included
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Prototypes
+static void perft(SearchContext* search, unsigned int depth, vector<CardMove>* played,
+                  PerftCount* count);
+static unsigned long long runPerft(const vector<Tableau>& tableaus, unsigned int depth,
+                                   bool divide);
+static bool checkKnownCounts();
+static void usage();
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Implementations
+
+// main
+// perft [options] [DEALS]
+// Counts from each deal in the file DEALS, one per line as parseDeal reads
+// them, or from Microsoft deals picked with -m. Options:
+// -d N: count to depth N (default 4)
+// -m FIRST[-LAST]: count from Microsoft deals FIRST to LAST
+// -s: split the count at the first move, to find where two counts part
+// -c: check the generator against the counts it is known to give, and fail
+//   if any differ
+// The moves come from getPossibleMoves and are played with makeMove, so the
+// auto moves after each are part of it, as in a search; nothing is filtered
+// and no position is skipped for having been seen before.
+int main(int argc, char** argv) {
+  unsigned int depth = kDefaultDepth, badLine = 0;
+  unsigned long firstDeal = 0, lastDeal = 0, deal;
+  bool divide = false;
+  vector<vector<Tableau> > deals;
+  vector<Tableau> tableaus;
+  size_t i;
+
+  while (argc > 1 && argv[1][0] == '-') {
+    if (strcmp(argv[1], "-s") == 0) {
+      divide = true;
+    }
+    else if (strcmp(argv[1], "-c") == 0) {
+      return checkKnownCounts() ? 0 : 1;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-d") == 0) {
+      depth = (unsigned int)atoi(argv[2]);
+      argc--;
+      argv++;
+    }
+    else if (argc > 2 && strcmp(argv[1], "-m") == 0) {
+      char* end;
+      firstDeal = strtoul(argv[2], &end, 10);
+      lastDeal = (*end == '-') ? strtoul(end + 1, NULL, 10) : firstDeal;
+      argc--;
+      argv++;
+    }
+    else {
+      usage();
+      return 1;
+    }
+    argc--;
+    argv++;
+  }
+  if (argc > 2 || (argc == 1 && firstDeal == 0)) {
+    usage();
+    return 1;
+  }
+
+  for (deal = firstDeal; deal != 0 && deal <= lastDeal; deal++) {
+    if (!getMicrosoftDeal(deal, &tableaus)) {
+      cerr << "There is no deal number " << deal << endl;
+      return 1;
+    }
+    cout << "deal " << deal << ":" << endl;
+    runPerft(tableaus, depth, divide);
+  }
+  if (argc == 2) {
+    if (!loadDeals(argv[1], &deals, &badLine)) {
+      if (badLine != 0) {
+        cerr << argv[1] << ":" << badLine << ": not a deal" << endl;
+      }
+      else {
+        cerr << "Can't read deals from " << argv[1] << endl;
+      }
+      return 1;
+    }
+    for (i = 0; i < deals.size(); i++) {
+      cout << argv[1] << " deal " << i + 1 << ":" << endl;
+      runPerft(deals[i], depth, divide);
+    }
+  }
+  return 0;
+}
+
+// perft
+// Adds the leaves and positions below the current one, depth moves down, to
+// *count. The last level is counted without playing its moves.
+static void perft(SearchContext* search, unsigned int depth, vector<CardMove>* played,
+                  PerftCount* count) {
+  MoveBuffer moves;
+  unsigned int i;
+
+  count->nodes++;
+  if (depth == 0) {
+    count->leaves++;
+    return;
+  }
+  search->getPossibleMoves(&moves);
+  if (depth == 1) {
+    count->leaves += moves.size();
+    count->nodes += moves.size();
+    return;
+  }
+  for (i = 0; i < moves.size(); i++) {
+    CardMove move = moves[i].toCardMove();
+    search->makeMove(played, move);
+    perft(search, depth - 1, played, count);
+    search->undoMove(played, move);
+  }
+}
+
+// runPerft
+// Counts from the deal to each depth up to depth in turn, printing the
+// leaves and the rate for each, and returns the leaves at the last. With
+// divide, the last depth is also broken down by the first move.
+static unsigned long long runPerft(const vector<Tableau>& tableaus, unsigned int depth,
+                                   bool divide) {
+  SearchContext search;
+  vector<CardMove> played;
+  PerftCount count;
+  MoveBuffer moves;
+  chrono::steady_clock::time_point start;
+  double seconds;
+  unsigned int d, i;
+
+  count.leaves = 0;
+  for (d = 1; d <= depth; d++) {
+    search.setSearchPosition(tableaus, played);
+    count.leaves = 0;
+    count.nodes = 0;
+    start = chrono::steady_clock::now();
+    perft(&search, d, &played, &count);
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "  depth " << d << ": " << count.leaves << " leaves, " << count.nodes
+         << " positions, " << fixed << setprecision(0)
+         << (seconds > 0 ? count.nodes / seconds : 0) << " positions/s" << endl;
+    cout.unsetf(ios_base::fixed);
+  }
+
+  if (divide && depth > 0) {
+    search.setSearchPosition(tableaus, played);
+    search.getPossibleMoves(&moves);
+    for (i = 0; i < moves.size(); i++) {
+      CardMove move = moves[i].toCardMove();
+      PerftCount branch;
+      char *from, *to;
+
+      branch.leaves = 0;
+      branch.nodes = 0;
+      search.makeMove(&played, move);
+      perft(&search, depth - 1, &played, &branch);
+      search.undoMove(&played, move);
+      locString(&from, move.from);
+      locString(&to, move.dest);
+      // the card as parseTableau writes it
+      cout << "    " << int(move.card.num) << "cdhs"[move.card.suit] << " from "
+           << from << " to " << to << ": " << branch.leaves << endl;
+    }
+  }
+  return count.leaves;
+}
+
+// checkKnownCounts
+static bool checkKnownCounts() {
+  SearchContext search;
+  vector<Tableau> tableaus;
+  vector<CardMove> played;
+  PerftCount count;
+  bool passed = true;
+  size_t i;
+
+  for (i = 0; i < kKnownCountCount; i++) {
+    const KnownCount& known = kKnownCounts[i];
+    getMicrosoftDeal(known.deal, &tableaus);
+    search.setSearchPosition(tableaus, played);
+    count.leaves = 0;
+    count.nodes = 0;
+    perft(&search, known.depth, &played, &count);
+    cout << "deal " << known.deal << " depth " << known.depth << ": " << count.leaves;
+    if (count.leaves != known.leaves) {
+      cout << ", expected " << known.leaves << " FAIL";
+      passed = false;
+    }
+    cout << endl;
+  }
+  return passed;
+}
+
+static void usage() {
+  cerr << "usage: perft [-d depth] [-m first[-last]] [-s] [deals]" << endl
+       << "       perft -c" << endl;
+}